@@ -0,0 +1 @@
+./compile.sh -O2 && gcc tester/bench.c -L. -ljitc -O2 -o jitc-bench && (JITC_SCALAR_LEXER=1 ./jitc-bench $@ && ./jitc-bench $@) | tee bench_output.txt
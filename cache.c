@@ -0,0 +1,296 @@
+#include "cleanups.h"
+#include "dynamics.h"
+#include "jitc.h"
+#include "jitc_internal.h"
+
+#include "compares.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC "JITCTOK\x02"
+#define CACHE_NONE UINT32_MAX
+
+#define STRING_KEYWORD(x) [TOKEN_##x] = true,
+#define STRING_IGNORE(...)
+
+static const bool string_tokens[TOKEN_COUNT] = {
+    [TOKEN_IDENTIFIER] = true,
+    [TOKEN_STRING] = true,
+    TOKENS(STRING_KEYWORD, STRING_IGNORE, STRING_IGNORE)
+};
+
+typedef struct {
+    bytewriter_t* strings;
+    bytewriter_t* expansions;
+    bytewriter_t* body;
+    map(char*, uint32_t)* string_index;
+    map(uint64_t, uint32_t)* expansion_index;
+    uint32_t num_strings;
+} cache_writer_t;
+
+typedef struct {
+    const uint8_t* ptr;
+    const uint8_t* end;
+} cache_reader_t;
+
+typedef struct {
+    jitc_context_t* context;
+    list(char*)* data;
+    list(uint32_t)* lengths;
+    list(char*)* interned;
+} cache_strings_t;
+
+#define read_value(reader, type) ({ \
+    type _value; \
+    if (!read_bytes(reader, &_value, sizeof(type))) return 0; \
+    _value; \
+})
+
+static bool read_bytes(cache_reader_t* reader, void* data, size_t size) {
+    if ((size_t)(reader->end - reader->ptr) < size) return false;
+    memcpy(data, reader->ptr, size);
+    reader->ptr += size;
+    return true;
+}
+
+static string_t* cache_path(jitc_context_t* context, uint64_t key) {
+    string_t* path = str_new();
+    str_appendf(path, "%s/%016lx.jtc", context->cache_dir, key);
+    return path;
+}
+
+void jitc_set_cache_dir(jitc_context_t* context, const char* path) {
+    replace(context->cache_dir) = path ? strdup(path) : NULL;
+}
+
+uint64_t jitc_cache_key(const char* code, size_t length, const char* filename) {
+    uint64_t hash = hash_bytes(code, length);
+    hash = (hash ^ (filename ? hash_string(&filename) : 0)) * 0x100000001b3;
+    hash = (hash ^ jitc_hash_predefined()) * 0x100000001b3;
+    hash = (hash ^ hash_bytes(CACHE_MAGIC, sizeof(CACHE_MAGIC))) * 0x100000001b3;
+    hash = (hash ^ num_token_table_entries) * 0x100000001b3;
+    return hash;
+}
+
+static uint32_t write_blob(cache_writer_t* writer, const char* data, size_t length) {
+    bytewriter_int32(writer->strings, length);
+    for (size_t i = 0; i < length; i++) bytewriter_int8(writer->strings, data[i]);
+    bytewriter_int8(writer->strings, 0);
+    return writer->num_strings++;
+}
+
+static uint32_t write_string(cache_writer_t* writer, const char* str) {
+    if (!str) return CACHE_NONE;
+    map_add(writer->string_index) = (char*)str;
+    if (map_commit(writer->string_index)) map_get_value(writer->string_index) = write_blob(writer, str, strlen(str));
+    return map_get_value(writer->string_index);
+}
+
+static uint32_t write_expansion(jitc_context_t* context, cache_writer_t* writer, uint32_t expansion) {
+    if (expansion == 0) return 0;
+    uint64_t key = expansion;
+    if (map_find(writer->expansion_index, &key)) return map_get_value(writer->expansion_index);
+    jitc_expansion_t* entry = &list_get(context->expansions, expansion);
+    uint32_t parent = write_expansion(context, writer, entry->parent);
+    bytewriter_int32(writer->expansions, write_string(writer, entry->location.filename));
+    bytewriter_int32(writer->expansions, entry->location.row);
+    bytewriter_int32(writer->expansions, entry->location.col);
+    bytewriter_int32(writer->expansions, parent);
+    map_add(writer->expansion_index) = key;
+    map_commit(writer->expansion_index);
+    return map_get_value(writer->expansion_index) = map_size(writer->expansion_index);
+}
+
+static void write_tokens(jitc_context_t* context, cache_writer_t* writer, list_t* _tokens) {
+    list(jitc_token_t)* tokens = _tokens;
+    bytewriter_int32(writer->body, tokens ? list_size(tokens) : 0);
+    for (size_t i = 0; tokens && i < list_size(tokens); i++) {
+        jitc_token_t* token = &list_get(tokens, i);
+        uint8_t flags;
+        memcpy(&flags, &token->flags, sizeof(flags));
+        bytewriter_int8(writer->body, token->disabled);
+        bytewriter_int8(writer->body, token->type);
+        bytewriter_int8(writer->body, flags);
+        bytewriter_int32(writer->body, write_expansion(context, writer, token->expansion));
+        bytewriter_int32(writer->body, token->row);
+        bytewriter_int32(writer->body, token->col);
+        bytewriter_int32(writer->body, write_string(writer, token->filename));
+        if (token->type == TOKEN_EMBED) bytewriter_int64(writer->body, write_blob(writer, token->value.embed->data, token->value.embed->size));
+        else if (string_tokens[token->type]) bytewriter_int64(writer->body, write_string(writer, token->value.string));
+        else bytewriter_int64(writer->body, token->value.integer);
+    }
+}
+
+void jitc_cache_store(jitc_context_t* context, uint64_t key, const char* filename, list_t* tokens, list_t* dependencies, list_t* _deps) {
+    list(jitc_cache_dep_t)* deps = _deps;
+    smartptr(list(jitc_cache_dep_t)) unique = list_new(jitc_cache_dep_t);
+    for (size_t i = 0; i < list_size(deps); i++) {
+        jitc_cache_dep_t* dep = &list_get(deps, i);
+        size_t j = 0;
+        for (; j < list_size(unique); j++) if (strcmp(list_get(unique, j).name, dep->name) == 0) break;
+        if (j == list_size(unique)) list_add(unique) = *dep;
+        else list_get(unique, j).prelude |= dep->prelude;
+    }
+    smartptr(map(char*, uint32_t)) string_index = hashmap_new(hash_string, compare_string, char*, uint32_t);
+    smartptr(map(uint64_t, uint32_t)) expansion_index = hashmap_new(hash_int64, compare_int64, uint64_t, uint32_t);
+    cache_writer_t writer = {
+        .strings = bytewriter_new(),
+        .expansions = bytewriter_new(),
+        .body = bytewriter_new(),
+        .string_index = (void*)string_index,
+        .expansion_index = (void*)expansion_index,
+    };
+    defer {
+        free(bytewriter_delete(writer.strings));
+        free(bytewriter_delete(writer.expansions));
+        free(bytewriter_delete(writer.body));
+    }
+    uint32_t filename_index = write_string(&writer, filename);
+    bytewriter_int32(writer.body, list_size(unique));
+    for (size_t i = 0; i < list_size(unique); i++) {
+        jitc_cache_dep_t* dep = &list_get(unique, i);
+        bytewriter_int32(writer.body, write_string(&writer, dep->name));
+        bytewriter_int64(writer.body, dep->hash);
+        bytewriter_int8(writer.body, dep->prelude | dep->missing << 1);
+    }
+    write_tokens(context, &writer, dependencies);
+    write_tokens(context, &writer, tokens);
+    uint32_t header[] = { filename_index, writer.num_strings, map_size(expansion_index) };
+    smartptr(string_t) path = cache_path(context, key);
+    smartptr(string_t) temp = str_new();
+    str_appendf(temp, "%s.%d.tmp", str_data(path), (int)getpid());
+    FILE* file = fopen(str_data(temp), "wb");
+    if (!file) return;
+    fwrite(CACHE_MAGIC, 1, 8, file);
+    fwrite(&key, sizeof(key), 1, file);
+    fwrite(header, sizeof(header), 1, file);
+    fwrite(bytewriter_data(writer.strings), 1, bytewriter_size(writer.strings), file);
+    fwrite(bytewriter_data(writer.expansions), 1, bytewriter_size(writer.expansions), file);
+    fwrite(bytewriter_data(writer.body), 1, bytewriter_size(writer.body), file);
+    bool failed = ferror(file);
+    if (fclose(file) != 0 || failed || rename(str_data(temp), str_data(path)) != 0) remove(str_data(temp));
+}
+
+// strings are interned on first use, so embedded blobs never reach the interner
+static bool read_string(cache_strings_t* strings, uint32_t index, const char** string) {
+    if (index == CACHE_NONE) *string = NULL;
+    else if (index < list_size(strings->data)) {
+        char** interned = &list_get(strings->interned, index);
+        *string = *interned = *interned ?: jitc_append_string_n(strings->context, list_get(strings->data, index), list_get(strings->lengths, index));
+    }
+    else return false;
+    return true;
+}
+
+static bool read_embed(cache_strings_t* strings, uint32_t index, jitc_embed_t** embed) {
+    if (index >= list_size(strings->data)) return false;
+    *embed = jitc_embed_bytes(strings->context, list_get(strings->data, index), list_get(strings->lengths, index));
+    return true;
+}
+
+static bool read_tokens(cache_reader_t* reader, cache_strings_t* strings, list_t* _expansions, list_t* _tokens) {
+    list(uint32_t)* expansions = _expansions;
+    list(jitc_token_t)* tokens = _tokens;
+    uint32_t num_tokens = read_value(reader, uint32_t);
+    for (uint32_t i = 0; i < num_tokens; i++) {
+        jitc_token_t token = {};
+        uint8_t flags;
+        token.disabled = read_value(reader, uint8_t);
+        token.type = read_value(reader, uint8_t);
+        flags = read_value(reader, uint8_t);
+        memcpy(&token.flags, &flags, sizeof(flags));
+        uint32_t expansion = read_value(reader, uint32_t);
+        token.row = read_value(reader, int32_t);
+        token.col = read_value(reader, int32_t);
+        uint32_t filename = read_value(reader, uint32_t);
+        uint64_t value = read_value(reader, uint64_t);
+        if (token.type >= TOKEN_COUNT || expansion >= list_size(expansions)) return false;
+        token.expansion = list_get(expansions, expansion);
+        if (!read_string(strings, filename, &token.filename)) return false;
+        if (token.type == TOKEN_EMBED) {
+            if (value > CACHE_NONE || !read_embed(strings, value, &token.value.embed)) return false;
+        }
+        else if (!string_tokens[token.type]) token.value.integer = value;
+        else if (value > CACHE_NONE || !read_string(strings, value, (const char**)&token.value.string)) return false;
+        list_add(tokens) = token;
+    }
+    return true;
+}
+
+list_t* jitc_cache_load(jitc_context_t* context, uint64_t key, const char* filename, list_t* dependencies) {
+    smartptr(string_t) path = cache_path(context, key);
+    jitc_source_file_t file;
+    if (!jitc_load_file(context, str_data(path), &file)) {
+        jitc_destroy_error(jitc_get_error(context));
+        return NULL;
+    }
+    defer { jitc_unload_file(&file); }
+    cache_reader_t reader = { (uint8_t*)file.data, (uint8_t*)file.data + file.size };
+    char magic[8];
+    if (!read_bytes(&reader, magic, sizeof(magic)) || memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0) return NULL;
+    if (read_value(&reader, uint64_t) != key) return NULL;
+    uint32_t filename_index = read_value(&reader, uint32_t);
+    uint32_t num_strings = read_value(&reader, uint32_t);
+    uint32_t num_expansions = read_value(&reader, uint32_t);
+    smartptr(list(char*)) data = list_new(char*);
+    smartptr(list(uint32_t)) lengths = list_new(uint32_t);
+    smartptr(list(char*)) interned = list_new(char*);
+    for (uint32_t i = 0; i < num_strings; i++) {
+        uint32_t length = read_value(&reader, uint32_t);
+        if ((size_t)(reader.end - reader.ptr) <= length || reader.ptr[length] != 0) return NULL;
+        list_add(data) = (char*)reader.ptr;
+        list_add(lengths) = length;
+        list_add(interned) = NULL;
+        reader.ptr += length + 1;
+    }
+    cache_strings_t strings = { context, (void*)data, (void*)lengths, (void*)interned };
+    const char* stored_filename;
+    if (!read_string(&strings, filename_index, &stored_filename)) return NULL;
+    if (!stored_filename != !filename || (filename && strcmp(stored_filename, filename) != 0)) return NULL;
+    cache_reader_t expansion_reader = reader;
+    if ((size_t)(reader.end - reader.ptr) < (size_t)num_expansions * 16) return NULL;
+    reader.ptr += (size_t)num_expansions * 16;
+    uint32_t num_deps = read_value(&reader, uint32_t);
+    smartptr(list(jitc_cache_dep_t)) deps = list_new(jitc_cache_dep_t);
+    for (uint32_t i = 0; i < num_deps; i++) {
+        jitc_cache_dep_t dep;
+        uint32_t name = read_value(&reader, uint32_t);
+        dep.hash = read_value(&reader, uint64_t);
+        uint8_t flags = read_value(&reader, uint8_t);
+        dep.prelude = flags & 1;
+        dep.missing = flags & 2;
+        if (!read_string(&strings, name, &dep.name) || !dep.name) return NULL;
+        if (dep.missing) {
+            if (jitc_vfs_lookup(context, dep.name)) return NULL;
+            continue;
+        }
+        uint64_t hash;
+        if (!jitc_header_hash(context, dep.name, &hash) || hash != dep.hash) return NULL;
+        list_add(deps) = dep;
+    }
+    for (size_t i = 0; i < list_size(deps); i++) {
+        jitc_cache_dep_t* dep = &list_get(deps, i);
+        if (dep->prelude && !jitc_attach_import(context, dep->name, dep->hash)) return NULL;
+    }
+    smartptr(list(uint32_t)) expansions = list_new(uint32_t);
+    list_add(expansions) = 0;
+    for (uint32_t i = 0; i < num_expansions; i++) {
+        uint32_t filename = read_value(&expansion_reader, uint32_t);
+        int row = read_value(&expansion_reader, int32_t);
+        int col = read_value(&expansion_reader, int32_t);
+        uint32_t parent = read_value(&expansion_reader, uint32_t);
+        const char* location;
+        if (parent >= list_size(expansions) || !read_string(&strings, filename, &location)) return NULL;
+        list_add(expansions) = jitc_add_expansion(context, list_get(expansions, parent), location, row, col);
+    }
+    smartptr(list(jitc_token_t)) depends = list_new(jitc_token_t);
+    smartptr(list(jitc_token_t)) tokens = list_new(jitc_token_t);
+    if (!read_tokens(&reader, &strings, expansions, depends)) return NULL;
+    if (!read_tokens(&reader, &strings, expansions, tokens)) return NULL;
+    if (dependencies) for (size_t i = 0; i < list_size(depends); i++)
+        list_add((list(jitc_token_t)*)dependencies) = list_get(depends, i);
+    return move(tokens);
+}
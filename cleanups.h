@@ -62,7 +62,6 @@ void __cleanup_stack_t(void* stack);
 void __cleanup_queue_t(void* queue);
 void __cleanup_bytewriter_t(void* writer);
 
-void __cleanup_jitc_ast_t(void* type);
 void __cleanup_jitc_context_t(void* context);
 
 #define __cleanup_list(...) __cleanup_list_t
@@ -5,6 +5,7 @@
 #include <stdint.h>
 
 static int compare_string(const void* a, const void* b) {
+    if (*(char**)a == *(char**)b) return 0;
     return strcmp(*(char**)a, *(char**)b);
 }
 
@@ -12,4 +13,30 @@ static int compare_int64(const void* a, const void* b) {
     return (*(uint64_t*)a > *(uint64_t*)b) - (*(uint64_t*)a < *(uint64_t*)b);
 }
 
+static uint64_t hash_string(const void* key) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (const char* str = *(char**)key; *str; str++) {
+        hash ^= (uint8_t)*str;
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+static uint64_t hash_bytes(const void* data, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= ((uint8_t*)data)[i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+static uint64_t hash_int64(const void* key) {
+    uint64_t hash = *(uint64_t*)key;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccd;
+    hash ^= hash >> 33;
+    return hash;
+}
+
 #endif
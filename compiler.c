@@ -64,6 +64,30 @@ static void* make_executable(jitc_context_t* context, void* ptr, size_t size) {
     return chunk;
 }
 
+static jitc_func_trampoline_t* make_trampoline(jitc_context_t* context, jitc_func_cell_t* cell) {
+    autofree jitc_func_trampoline_t* func = malloc(sizeof(jitc_func_trampoline_t));
+    func->addr = cell;
+    func->mov_rax[0] = 0x48; func->mov_rax[1] = 0xB8;
+    func->jmp_rax[0] = 0xFF; func->jmp_rax[1] = 0x20;
+    return make_executable(context, func, sizeof(jitc_func_trampoline_t));
+}
+
+jitc_func_trampoline_t* jitc_relocate_function(jitc_context_t* context, jitc_func_trampoline_t* func, map_t* _copies) {
+    map(jitc_variable_t*, jitc_variable_t*)* copies = _copies;
+    jitc_func_cell_t* cell = arena_memdup(context->arena, func->addr, sizeof(jitc_func_cell_t));
+    cell->relocs = cell->num_relocs ? arena_memdup(context->arena, func->addr->relocs, sizeof(jitc_reloc_t) * cell->num_relocs) : NULL;
+    autofree uint8_t* code = memcpy(malloc(cell->size), func->addr->ptr, cell->size);
+    for (size_t i = 0; i < cell->num_relocs; i++) {
+        jitc_reloc_t* reloc = &cell->relocs[i];
+        if (!map_find(copies, &reloc->var)) continue;
+        reloc->var = map_get_value(copies);
+        memcpy(code + reloc->offset, &(void*){ &reloc->var->ptr }, sizeof(void*));
+    }
+    cell->ptr = make_executable(context, code, cell->size);
+    cell->curr_ptr = func->addr->curr_ptr == func->addr->ptr ? cell->ptr : func->addr->curr_ptr;
+    return make_trampoline(context, cell);
+}
+
 void jitc_delete_memchunks(jitc_context_t* context) {
     for (size_t i = 0; i < list_size(context->memchunks); i++) {
         jitc_memchunk_t* memchunk = &list_get(context->memchunks, i);
@@ -411,13 +435,22 @@ static bool assemble(list_t* _ir, jitc_ast_t* ast, map_t* _variable_map, jitc_bi
             return false;
         case AST_Initializer: {
             assemble(ir, ast->init.store_to, variable_map, 0);
-            list_add(ir) = IR(IR_init, INT(ast->exprtype->size), INT(ast->exprtype->alignment));
+            jitc_ast_t* first = list_size(ast->init.items) == 1 ? list_get(ast->init.items, 0) : NULL;
+            if (!first || first->node_type != AST_Blob || first->blob.size != ast->exprtype->size)
+                list_add(ir) = IR(IR_init, INT(ast->exprtype->size), INT(ast->exprtype->alignment));
             size_t curr_offset = 0;
             for (size_t i = 0; i < list_size(ast->init.items); i++) {
                 size_t diff = list_get(ast->init.offsets, i) - curr_offset;
                 list_add(ir) = IR(IR_offset, INT(diff));
-                assemble(ir, list_get(ast->init.items, i), variable_map, 0);
-                list_add(ir) = IR(IR_store);
+                jitc_ast_t* item = list_get(ast->init.items, i);
+                if (item->node_type == AST_Blob) {
+                    list_add(ir) = IR(IR_laddr, PTR(item->blob.data), INT(Type_Struct), INT(false));
+                    list_add(ir) = IR(IR_copy, INT(item->blob.size), INT(1));
+                }
+                else {
+                    assemble(ir, item, variable_map, 0);
+                    list_add(ir) = IR(IR_store);
+                }
                 curr_offset += diff;
             }
             list_add(ir) = IR(IR_offset, INT(-curr_offset));
@@ -443,7 +476,7 @@ void jitc_compile(jitc_context_t* context, jitc_ast_t* ast) {
             if (!ast->decl.type->name) break;
             jitc_variable_t* var = jitc_get_or_static(context, ast->decl.type->name);
             if ((var->decltype == Decltype_Static || var->decltype == Decltype_None) && var->type->kind != Type_Function)
-                var->ptr = var->ptr ?: calloc(var->type->size, 1);
+                var->ptr = var->ptr ?: memset(arena_alloc(context->arena, var->type->size), 0, var->type->size);
             ast->decl.variable = var;
         } break;
         case AST_Binary:
@@ -460,7 +493,9 @@ void jitc_compile(jitc_context_t* context, jitc_ast_t* ast) {
             else for (size_t i = 0; i < list_size(ast->init.items); i++) {
                 jitc_ast_t* node = list_get(ast->init.items, i);
                 void* ptr = (uint8_t*)var->ptr + list_get(ast->init.offsets, i);
-                memcpy(ptr, &node->integer.value, node->exprtype->size);
+                if (node->node_type == AST_Blob) memcpy(ptr, node->blob.data->ptr, node->blob.size);
+                else if (node->node_type == AST_Floating && node->floating.is_single_precision) memcpy(ptr, &(float){node->floating.value}, sizeof(float));
+                else memcpy(ptr, &node->integer.value, node->exprtype->size);
             }
         } break;
         case AST_Function: {
@@ -472,19 +507,34 @@ void jitc_compile(jitc_context_t* context, jitc_ast_t* ast) {
 
             smartptr(map(char*, stackvar_t)) variable_map = map_new(compare_string, char*, stackvar_t);
             smartptr(list(jitc_ir_t)) ir = list_new(jitc_ir_t);
+            smartptr(list(jitc_reloc_t)) relocs = list_new(jitc_reloc_t);
             bytewriter_t* writer = bytewriter_new();
             bool is_return = false;
+            map_add_many(variable_map, map_size(global_scope->variables));
             for (size_t i = 0; i < map_size(global_scope->variables); i++) {
                 map_index(global_scope->variables, i);
                 const char* name = map_get_key(global_scope->variables);
                 jitc_variable_t* var = map_get_value(global_scope->variables);
                 map_add(variable_map) = (char*)name;
-                map_commit(variable_map);
                 stackvar_t* stackvar = &map_get_value(variable_map);
                 stackvar->is_global = stackvar->is_leaf = true;
                 stackvar->var.type = var->type;
                 stackvar->var.ptr = var;
             }
+            map_commit_many(variable_map, map_size(global_scope->variables));
+            for (size_t i = list_size(context->imports) - 1; i < list_size(context->imports); i--) {
+                jitc_scope_t* scope = list_get(context->imports, i);
+                for (size_t j = 0; j < map_size(scope->variables); j++) {
+                    map_index(scope->variables, j);
+                    map_add(variable_map) = map_get_key(scope->variables);
+                    if (!map_commit(variable_map)) continue;
+                    jitc_variable_t* var = map_get_value(scope->variables);
+                    stackvar_t* stackvar = &map_get_value(variable_map);
+                    stackvar->is_global = stackvar->is_leaf = true;
+                    stackvar->var.type = var->type;
+                    stackvar->var.ptr = var;
+                }
+            }
             list_add(ir) = IR(IR_func, PTR(ast->func.variable), INT(get_stack_size(variable_map, ast->func.body, ast->func.variable)));
             for (size_t i = 0; i < list_size(ast->func.body->list.inner); i++) {
                 jitc_ast_t* node = list_get(ast->func.body->list.inner, i);
@@ -499,25 +549,20 @@ void jitc_compile(jitc_context_t* context, jitc_ast_t* ast) {
                 }
             }
             list_add(ir) = IR(IR_func_end);
-            jitc_asm_emit(writer, ir);
+            jitc_asm_emit(writer, ir, relocs);
             size_t size = bytewriter_size(writer);
             autofree void* data = bytewriter_delete(writer);
             void* func_ptr = make_executable(context, data, size);
 #if JITC_DEBUG || JITC_DEBUG_GDB
             jitc_gdb_map_function(func_ptr, (char*)func_ptr + size, ast->func.variable->name);
 #endif
-            if (var->func) {
-                var->func->addr->ptr = func_ptr;
-                var->func->addr->size = size;
-            }
-            else {
-                autofree jitc_func_trampoline_t* func = malloc(sizeof(jitc_func_trampoline_t));
-                func->addr = malloc(sizeof(jitc_func_cell_t));
-                func->addr->ptr = func_ptr;
-                func->addr->size = size;
-                func->mov_rax[0] = 0x48; func->mov_rax[1] = 0xB8;
-                func->jmp_rax[0] = 0xFF; func->jmp_rax[1] = 0x20;
-                var->func = make_executable(context, func, sizeof(jitc_func_trampoline_t));
+            jitc_func_cell_t* cell = var->func ? var->func->addr : arena_alloc(context->arena, sizeof(jitc_func_cell_t));
+            cell->ptr = func_ptr;
+            cell->size = size;
+            cell->num_relocs = list_size(relocs);
+            cell->relocs = list_size(relocs) ? arena_memdup(context->arena, &list_get(relocs, 0), sizeof(jitc_reloc_t) * list_size(relocs)) : NULL;
+            if (!var->func) {
+                var->func = make_trampoline(context, cell);
 #if JITC_DEBUG || JITC_DEBUG_GDB
                 jitc_gdb_map_function(var->func, (char*)var->func + sizeof(jitc_func_trampoline_t), ast->func.variable->name);
 #endif
@@ -21,6 +21,33 @@ struct bytewriter_t {
     size_t size, capacity;
 };
 
+typedef struct arena_block_t {
+    struct arena_block_t* next;
+    size_t size, used;
+    uint8_t data[] __attribute__((aligned(16)));
+} arena_block_t;
+
+struct arena_t {
+    arena_block_t* blocks;
+    size_t block_size;
+};
+
+typedef struct {
+    uint64_t hash;
+    uint32_t id;
+    uint32_t length;
+    char data[];
+} interned_t;
+
+struct interner_t {
+    arena_t* arena;
+    interned_t** table;
+    size_t length, capacity;
+};
+
+#define BUCKET_EMPTY 0
+#define BUCKET_TOMBSTONE UINT32_MAX
+
 string_t* str_new() {
     string_t* str = malloc(sizeof(string_t));
     str->capacity = 64;
@@ -44,11 +71,14 @@ void str_clear(string_t* str) {
 }
 
 void str_append(string_t* str, const char* other) {
-    int len = strlen(other);
+    str_append_n(str, other, strlen(other));
+}
+
+void str_append_n(string_t* str, const char* other, size_t len) {
     int prev_cap = str->capacity;
     while (str->length + len + 1 >= str->capacity) str->capacity += 64;
     if (str->capacity != prev_cap) str->data = realloc(str->data, str->capacity);
-    strcpy(str->data + str->length, other);
+    memcpy(str->data + str->length, other, len);
     str->length += len;
     str->data[str->length] = 0;
 }
@@ -131,12 +161,157 @@ void* bytewriter_delete(bytewriter_t* writer) {
     return copy;
 }
 
+arena_t* arena_new(size_t block_size) {
+    arena_t* arena = malloc(sizeof(arena_t));
+    arena->blocks = NULL;
+    arena->block_size = block_size;
+    return arena;
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+    size = (size + 15) & ~15;
+    arena_block_t* block = arena->blocks;
+    if (!block || block->used + size > block->size) {
+        size_t block_size = size > arena->block_size / 4 ? size : arena->block_size;
+        block = malloc(sizeof(arena_block_t) + block_size);
+        block->size = block_size;
+        block->used = 0;
+        if (block_size == arena->block_size || !arena->blocks) {
+            block->next = arena->blocks;
+            arena->blocks = block;
+        }
+        else {
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+        }
+    }
+    void* ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+void* arena_realloc(arena_t* arena, void* ptr, size_t old_size, size_t new_size) {
+    if (!arena) return realloc(ptr, new_size);
+    return memcpy(arena_alloc(arena, new_size), ptr, old_size);
+}
+
+void* arena_memdup(arena_t* arena, const void* ptr, size_t size) {
+    if (!ptr) return NULL;
+    return memcpy(arena_alloc(arena, size), ptr, size);
+}
+
+char* arena_strdup(arena_t* arena, const char* str, size_t length) {
+    char* copy = arena_alloc(arena, length + 1);
+    memcpy(copy, str, length);
+    copy[length] = 0;
+    return copy;
+}
+
+void arena_clear(arena_t* arena) {
+    arena_block_t* block = arena->blocks;
+    if (!block) return;
+    arena_block_t* next = block->next;
+    while (next) {
+        arena_block_t* tmp = next->next;
+        free(next);
+        next = tmp;
+    }
+    block->next = NULL;
+    block->used = 0;
+}
+
+void arena_delete(arena_t* arena) {
+    arena_block_t* block = arena->blocks;
+    while (block) {
+        arena_block_t* next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+interner_t* interner_new() {
+    interner_t* interner = malloc(sizeof(interner_t));
+    interner->arena = arena_new(16384);
+    interner->length = 0;
+    interner->capacity = 256;
+    interner->table = calloc(interner->capacity, sizeof(interned_t*));
+    return interner;
+}
+
+size_t interner_size(interner_t* interner) {
+    return interner->length;
+}
+
+const char* interner_add(interner_t* interner, const char* str, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)str[i];
+        hash *= 0x100000001b3;
+    }
+    size_t mask = interner->capacity - 1;
+    size_t i = hash & mask;
+    for (interned_t* entry; (entry = interner->table[i]); i = (i + 1) & mask) {
+        if (entry->hash == hash && entry->length == length && memcmp(entry->data, str, length) == 0) return entry->data;
+    }
+    interned_t* entry = arena_alloc(interner->arena, sizeof(interned_t) + length + 1);
+    entry->hash = hash;
+    entry->id = interner->length++;
+    entry->length = length;
+    memcpy(entry->data, str, length);
+    entry->data[length] = 0;
+    interner->table[i] = entry;
+    if (interner->length * 2 > interner->capacity) {
+        interned_t** old = interner->table;
+        interner->capacity *= 2;
+        interner->table = calloc(interner->capacity, sizeof(interned_t*));
+        mask = interner->capacity - 1;
+        for (size_t j = 0; j < interner->capacity / 2; j++) {
+            if (!old[j]) continue;
+            size_t k = old[j]->hash & mask;
+            while (interner->table[k]) k = (k + 1) & mask;
+            interner->table[k] = old[j];
+        }
+        free(old);
+    }
+    return entry->data;
+}
+
+uint64_t interner_hash(const char* str) {
+    return ((interned_t*)(str - offsetof(interned_t, data)))->hash;
+}
+
+uint32_t interner_id(const char* str) {
+    return ((interned_t*)(str - offsetof(interned_t, data)))->id;
+}
+
+size_t interner_length(const char* str) {
+    return ((interned_t*)(str - offsetof(interned_t, data)))->length;
+}
+
+void interner_delete(interner_t* interner) {
+    arena_delete(interner->arena);
+    free(interner->table);
+    free(interner);
+}
+
 list_t* __list_new(size_t item_size) {
     __list_t* list = malloc(sizeof(__list_t));
     list->capacity = 4;
     list->length = 0;
     list->item_size = item_size;
     list->list = malloc(item_size * list->capacity);
+    list->arena = NULL;
+    return list;
+}
+
+list_t* __arena_list_new(arena_t* arena, size_t item_size) {
+    __list_t* list = arena_alloc(arena, sizeof(__list_t));
+    list->capacity = 4;
+    list->length = 0;
+    list->item_size = item_size;
+    list->list = arena_alloc(arena, item_size * list->capacity);
+    list->arena = arena;
     return list;
 }
 
@@ -148,11 +323,15 @@ void list_clear(list_t* list) {
     ((__list_t*)list)->length = 0;
 }
 
+void list_truncate(list_t* list, size_t size) {
+    if (size < ((__list_t*)list)->length) ((__list_t*)list)->length = size;
+}
+
 void* __list_add(list_t* _list) {
     __list_t* list = _list;
     if (list->length == list->capacity) {
         list->capacity *= 2;
-        list->list = realloc(list->list, list->item_size * list->capacity);
+        list->list = arena_realloc(list->arena, list->list, list->item_size * list->length, list->item_size * list->capacity);
     }
     return &list->list[list->length++ * list->item_size];
 }
@@ -176,10 +355,141 @@ void list_remove(list_t* _list, size_t index) {
 
 void list_delete(list_t* _list) {
     __list_t* list = _list;
+    if (list->arena) return;
     free(list->list);
     free(list);
 }
 
+static __bucket_t* hashindex_find(__hashindex_t* index, uint8_t* entries, size_t stride, compare_t compare, const void* key, uint64_t hash) {
+    if (index->capacity == 0) return NULL;
+    size_t mask = index->capacity - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        __bucket_t* bucket = &index->buckets[i];
+        if (bucket->index == BUCKET_EMPTY) return NULL;
+        if (bucket->index == BUCKET_TOMBSTONE || bucket->hash != (uint32_t)hash) continue;
+        if (compare(key, entries + (bucket->index - 1) * stride) == 0) return bucket;
+    }
+}
+
+static __bucket_t* hashindex_slot(__hashindex_t* index, uint64_t hash, size_t entry) {
+    size_t mask = index->capacity - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        if (index->buckets[i].index == entry + 1) return &index->buckets[i];
+    }
+}
+
+static void hashindex_insert(__hashindex_t* index, uint64_t hash, size_t entry) {
+    size_t mask = index->capacity - 1;
+    size_t i = hash & mask;
+    while (index->buckets[i].index != BUCKET_EMPTY && index->buckets[i].index != BUCKET_TOMBSTONE) i = (i + 1) & mask;
+    if (index->buckets[i].index == BUCKET_EMPTY) index->used++;
+    index->buckets[i].index = entry + 1;
+    index->buckets[i].hash = hash;
+}
+
+static void hashindex_rebuild(__hashindex_t* index, uint8_t* entries, size_t stride, size_t length) {
+    size_t capacity = 16;
+    while (capacity < length * 2) capacity *= 2;
+    free(index->buckets);
+    index->buckets = calloc(capacity, sizeof(__bucket_t));
+    index->capacity = capacity;
+    index->used = 0;
+    for (size_t i = 0; i < length; i++) {
+        hashindex_insert(index, index->hash(entries + i * stride), i);
+    }
+}
+
+// inserts entry length-1, returns the index of an equal entry if there already is one
+static size_t hashindex_commit(__hashindex_t* index, uint8_t* entries, size_t stride, size_t length, compare_t compare) {
+    uint8_t* entry = entries + (length - 1) * stride;
+    uint64_t hash = index->hash(entry);
+    __bucket_t* bucket = hashindex_find(index, entries, stride, compare, entry, hash);
+    if (bucket) return bucket->index - 1;
+    if ((index->used + 1) * 4 > index->capacity * 3) hashindex_rebuild(index, entries, stride, length);
+    else hashindex_insert(index, hash, length - 1);
+    return length - 1;
+}
+
+// removes entry at position, moving the last entry into its place
+static void hashindex_remove(__hashindex_t* index, uint8_t* entries, size_t stride, size_t length, size_t position) {
+    hashindex_slot(index, index->hash(entries + position * stride), position)->index = BUCKET_TOMBSTONE;
+    if (position == length - 1) return;
+    hashindex_slot(index, index->hash(entries + (length - 1) * stride), length - 1)->index = position + 1;
+    memcpy(entries + position * stride, entries + (length - 1) * stride, stride);
+}
+
+static size_t hashindex_commit_many(__hashindex_t* index, uint8_t* entries, size_t stride, size_t length, size_t count, compare_t compare) {
+    size_t new_length = length - count;
+    for (size_t i = length - count; i < length; i++) {
+        if (i != new_length) memcpy(entries + new_length * stride, entries + i * stride, stride);
+        if (hashindex_commit(index, entries, stride, new_length + 1, compare) == new_length) new_length++;
+    }
+    return new_length;
+}
+
+static void hashindex_clear(__hashindex_t* index) {
+    if (index->buckets) memset(index->buckets, 0, index->capacity * sizeof(__bucket_t));
+    index->used = 0;
+}
+
+// moves entry length-1 into its sorted position, or finds an equal entry already in place
+static bool sorted_insert(uint8_t* entries, size_t stride, size_t length, compare_t compare, size_t* position) {
+    uint8_t* entry = entries + (length - 1) * stride;
+    size_t low = 0, high = length - 1;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        int cmp = compare(entry, entries + mid * stride);
+        if (cmp == 0) {
+            *position = mid;
+            return false;
+        }
+        if (cmp < 0) high = mid;
+        else low = mid + 1;
+    }
+    *position = low;
+    if (low == length - 1) return true;
+    uint8_t copy[stride];
+    memcpy(copy, entry, stride);
+    memmove(entries + (low + 1) * stride, entries + low * stride, (length - 1 - low) * stride);
+    memcpy(entries + low * stride, copy, stride);
+    return true;
+}
+
+static size_t merge_runs(uint8_t* dest, uint8_t* left, size_t num_left, uint8_t* right, size_t num_right, size_t stride, compare_t compare, bool dedup) {
+    size_t length = 0, l = 0, r = 0;
+    while (l < num_left || r < num_right) {
+        uint8_t* entry;
+        if (r == num_right || (l < num_left && compare(left + l * stride, right + r * stride) <= 0)) entry = left + l++ * stride;
+        else entry = right + r++ * stride;
+        if (dedup && length != 0 && compare(entry, dest + (length - 1) * stride) == 0) continue;
+        memcpy(dest + length++ * stride, entry, stride);
+    }
+    return length;
+}
+
+// sorts the last count entries and merges them into the sorted ones before them, keeping the first of equal entries
+static size_t sorted_commit_many(uint8_t* entries, size_t stride, size_t length, size_t count, compare_t compare) {
+    if (count == 0) return length;
+    uint8_t* buffer = malloc(length * stride);
+    uint8_t* from = entries + (length - count) * stride;
+    uint8_t* to = buffer;
+    for (size_t width = 1; width < count; width *= 2) {
+        for (size_t low = 0; low < count; low += width * 2) {
+            size_t mid = low + width < count ? low + width : count;
+            size_t high = low + width * 2 < count ? low + width * 2 : count;
+            merge_runs(to + low * stride, from + low * stride, mid - low, from + mid * stride, high - mid, stride, compare, false);
+        }
+        uint8_t* tmp = from;
+        from = to;
+        to = tmp;
+    }
+    if (from == buffer) memcpy(entries + (length - count) * stride, buffer, count * stride);
+    length = merge_runs(buffer, entries, length - count, entries + (length - count) * stride, count, stride, compare, true);
+    memcpy(entries, buffer, length * stride);
+    free(buffer);
+    return length;
+}
+
 map_t* __map_new(compare_t compare, size_t key_size, size_t value_size) {
     __map_t* map = malloc(sizeof(__map_t));
     map->compare = compare;
@@ -189,6 +499,28 @@ map_t* __map_new(compare_t compare, size_t key_size, size_t value_size) {
     map->key_size = key_size;
     map->pair_size = key_size + value_size;
     map->entries = malloc(map->pair_size * map->capacity);
+    map->index = (__hashindex_t){};
+    map->arena = NULL;
+    return map;
+}
+
+map_t* __arena_map_new(arena_t* arena, compare_t compare, size_t key_size, size_t value_size) {
+    __map_t* map = arena_alloc(arena, sizeof(__map_t));
+    map->compare = compare;
+    map->capacity = 4;
+    map->length = 0;
+    map->cursor = NULL;
+    map->key_size = key_size;
+    map->pair_size = key_size + value_size;
+    map->entries = arena_alloc(arena, map->pair_size * map->capacity);
+    map->index = (__hashindex_t){};
+    map->arena = arena;
+    return map;
+}
+
+map_t* __hashmap_new(hash_t hash, compare_t compare, size_t key_size, size_t value_size) {
+    __map_t* map = __map_new(compare, key_size, value_size);
+    map->index.hash = hash;
     return map;
 }
 
@@ -198,10 +530,15 @@ size_t map_size(map_t* map) {
 
 void map_clear(map_t* map) {
     ((__map_t*)map)->length = 0;
+    hashindex_clear(&((__map_t*)map)->index);
 }
 
 bool map_find(map_t* _map, void* key) {
     __map_t* map = _map;
+    if (map->index.hash) {
+        __bucket_t* bucket = hashindex_find(&map->index, map->entries, map->pair_size, map->compare, key, map->index.hash(key));
+        return map->cursor = bucket ? &map->entries[(bucket->index - 1) * map->pair_size] : NULL;
+    }
     return map->cursor = bsearch(key, map->entries, map->length, map->pair_size, map->compare);
 }
 
@@ -213,23 +550,40 @@ void map_index(map_t* _map, size_t index) {
 
 bool map_commit(map_t* _map) {
     __map_t* map = _map;
-    void* last_entry = &map->entries[(map->length - 1) * map->pair_size];
-    if ((map->cursor = bsearch(last_entry, map->entries, map->length - 1, map->pair_size, map->compare))) {
+    if (map->index.hash) {
+        size_t index = hashindex_commit(&map->index, map->entries, map->pair_size, map->length, map->compare);
+        map->cursor = &map->entries[index * map->pair_size];
+        if (index == map->length - 1) return true;
         map->length--;
         return false;
     }
-    char copy[map->key_size];
-    memcpy(copy, last_entry, map->key_size);
-    qsort(map->entries, map->length, map->pair_size, map->compare);
-    map->cursor = bsearch(copy, map->entries, map->length, map->pair_size, map->compare);
-    return true;
+    size_t index;
+    bool inserted = sorted_insert(map->entries, map->pair_size, map->length, map->compare, &index);
+    map->cursor = &map->entries[index * map->pair_size];
+    if (!inserted) map->length--;
+    return inserted;
+}
+
+void map_add_many(map_t* _map, size_t count) {
+    __map_t* map = _map;
+    if (map->length + count <= map->capacity) return;
+    size_t prev_capacity = map->capacity;
+    while (map->length + count > map->capacity) map->capacity *= 2;
+    map->entries = arena_realloc(map->arena, map->entries, map->pair_size * prev_capacity, map->pair_size * map->capacity);
+}
+
+void map_commit_many(map_t* _map, size_t count) {
+    __map_t* map = _map;
+    map->cursor = NULL;
+    if (map->index.hash) map->length = hashindex_commit_many(&map->index, map->entries, map->pair_size, map->length, count, map->compare);
+    else map->length = sorted_commit_many(map->entries, map->pair_size, map->length, count, map->compare);
 }
 
 void* __map_add(map_t* _map) {
     __map_t* map = _map;
     if (map->length == map->capacity) {
         map->capacity *= 2;
-        map->entries = realloc(map->entries, map->pair_size * map->capacity);
+        map->entries = arena_realloc(map->arena, map->entries, map->pair_size * map->length, map->pair_size * map->capacity);
     }
     return map->cursor = &map->entries[map->length++ * map->pair_size];
 }
@@ -250,8 +604,8 @@ void map_remove(map_t* _map) {
     __map_t* map = _map;
     if (!map->cursor) return;
     size_t index = ((uintptr_t)map->cursor - (uintptr_t)map->entries) / map->pair_size;
-    map->length--;
-    if (index != map->length) memmove(
+    if (map->index.hash) hashindex_remove(&map->index, map->entries, map->pair_size, map->length--, index);
+    else if (index != --map->length) memmove(
         map->entries + index * map->pair_size,
         map->entries + (index + 1) * map->pair_size,
         map->pair_size * (map->length - index)
@@ -259,8 +613,25 @@ void map_remove(map_t* _map) {
     map->cursor = NULL;
 }
 
+map_t* map_copy(map_t* _map) {
+    __map_t* map = _map;
+    __map_t* copy = malloc(sizeof(__map_t));
+    *copy = *map;
+    copy->cursor = NULL;
+    copy->arena = NULL;
+    copy->entries = malloc(map->pair_size * map->capacity);
+    memcpy(copy->entries, map->entries, map->pair_size * map->length);
+    if (map->index.buckets) {
+        copy->index.buckets = malloc(sizeof(__bucket_t) * map->index.capacity);
+        memcpy(copy->index.buckets, map->index.buckets, sizeof(__bucket_t) * map->index.capacity);
+    }
+    return copy;
+}
+
 void map_delete(map_t* _map) {
     __map_t* map = _map;
+    if (map->arena) return;
+    free(map->index.buckets);
     free(map->entries);
     free(map);
 }
@@ -272,6 +643,13 @@ set_t* __set_new(compare_t compare, size_t item_size) {
     set->length = 0;
     set->item_size = item_size;
     set->list = malloc(set->item_size * set->capacity);
+    set->index = (__hashindex_t){};
+    return set;
+}
+
+set_t* __hashset_new(hash_t hash, compare_t compare, size_t item_size) {
+    __set_t* set = __set_new(compare, item_size);
+    set->index.hash = hash;
     return set;
 }
 
@@ -281,10 +659,15 @@ size_t set_size(set_t* set) {
 
 void set_clear(set_t* set) {
     ((__set_t*)set)->length = 0;
+    hashindex_clear(&((__set_t*)set)->index);
 }
 
 int set_indexof(set_t* _set, void* key) {
     __set_t* set = _set;
+    if (set->index.hash) {
+        __bucket_t* bucket = hashindex_find(&set->index, set->list, set->item_size, set->compare, key, set->index.hash(key));
+        return bucket ? bucket->index - 1 : -1;
+    }
     void* ptr = bsearch(key, set->list, set->length, set->item_size, set->compare);
     if (!ptr) return -1;
     return ((uintptr_t)ptr - (uintptr_t)set->list) / set->item_size;
@@ -308,8 +691,8 @@ void* __set_get(set_t* _set, size_t index) {
 void set_remove(set_t* _set, size_t index) {
     __set_t* set = _set;
     if (index >= set->length) return;
-    set->length--;
-    if (index != set->length) memmove(
+    if (set->index.hash) hashindex_remove(&set->index, set->list, set->item_size, set->length--, index);
+    else if (index != --set->length) memmove(
         set->list + index * set->item_size,
         set->list + (index + 1) * set->item_size,
         set->item_size * (set->length - index)
@@ -318,13 +701,33 @@ void set_remove(set_t* _set, size_t index) {
 
 bool set_commit(set_t* _set) {
     __set_t* set = _set;
-    if (bsearch(&set->list[(set->length - 1) * set->item_size], set->list, set->length - 1, set->item_size, set->compare)) return false;
-    qsort(set->list, set->length, set->item_size, set->compare);
-    return true;
+    if (set->index.hash) {
+        if (hashindex_commit(&set->index, set->list, set->item_size, set->length, set->compare) == set->length - 1) return true;
+        set->length--;
+        return false;
+    }
+    size_t index;
+    if (sorted_insert(set->list, set->item_size, set->length, set->compare, &index)) return true;
+    set->length--;
+    return false;
+}
+
+void set_add_many(set_t* _set, size_t count) {
+    __set_t* set = _set;
+    if (set->length + count <= set->capacity) return;
+    while (set->length + count > set->capacity) set->capacity *= 2;
+    set->list = realloc(set->list, set->item_size * set->capacity);
+}
+
+void set_commit_many(set_t* _set, size_t count) {
+    __set_t* set = _set;
+    if (set->index.hash) set->length = hashindex_commit_many(&set->index, set->list, set->item_size, set->length, count, set->compare);
+    else set->length = sorted_commit_many(set->list, set->item_size, set->length, count, set->compare);
 }
 
 void set_delete(set_t* _set) {
     __set_t* set = _set;
+    free(set->index.buckets);
     free(set->list);
     free(set);
 }
@@ -6,6 +6,7 @@
 #include <stdbool.h>
 
 typedef int(*compare_t)(const void* a, const void* b);
+typedef uint64_t(*hash_t)(const void* key);
 
 #define __RETURNS(str, field, func, ...) (*(typeof((str)->field))func(str __VA_OPT__(,) __VA_ARGS__))
 
@@ -14,6 +15,8 @@ typedef int(*compare_t)(const void* a, const void* b);
 
 typedef struct string_t string_t;
 typedef struct bytewriter_t bytewriter_t;
+typedef struct arena_t arena_t;
+typedef struct interner_t interner_t;
 
 typedef void list_t;
 typedef void map_t;
@@ -25,14 +28,28 @@ typedef struct {
     uint8_t* list;
     size_t item_size;
     size_t length, capacity;
+    arena_t* arena;
 } __list_t;
 
+typedef struct {
+    uint32_t index;
+    uint32_t hash;
+} __bucket_t;
+
+typedef struct {
+    hash_t hash;
+    __bucket_t* buckets;
+    size_t capacity, used;
+} __hashindex_t;
+
 typedef struct {
     uint8_t* entries;
     uint8_t* cursor;
     size_t key_size, pair_size;
     size_t length, capacity;
     compare_t compare;
+    __hashindex_t index;
+    arena_t* arena;
 } __map_t;
 
 typedef struct {
@@ -40,6 +57,7 @@ typedef struct {
     size_t item_size;
     size_t length, capacity;
     compare_t compare;
+    __hashindex_t index;
 } __set_t;
 
 typedef struct {
@@ -59,6 +77,7 @@ char* str_data(string_t* str);
 size_t str_length(string_t* str);
 void str_clear(string_t* str);
 void str_append(string_t* str, const char* other);
+void str_append_n(string_t* str, const char* other, size_t len);
 void str_appendf(string_t* str, const char* fmt, ...);
 void str_delete(string_t* str);
 
@@ -74,9 +93,27 @@ void bytewriter_float64(bytewriter_t* writer, double value);
 void bytewriter_pointer(bytewriter_t* writer, void* value);
 void* bytewriter_delete(bytewriter_t* writer);
 
+arena_t* arena_new(size_t block_size);
+void* arena_alloc(arena_t* arena, size_t size);
+void* arena_realloc(arena_t* arena, void* ptr, size_t old_size, size_t new_size);
+void* arena_memdup(arena_t* arena, const void* ptr, size_t size);
+char* arena_strdup(arena_t* arena, const char* str, size_t length);
+void arena_clear(arena_t* arena);
+void arena_delete(arena_t* arena);
+
+interner_t* interner_new();
+size_t interner_size(interner_t* interner);
+const char* interner_add(interner_t* interner, const char* str, size_t length);
+uint64_t interner_hash(const char* str);
+uint32_t interner_id(const char* str);
+size_t interner_length(const char* str);
+void interner_delete(interner_t* interner);
+
 list_t* __list_new(size_t item_size);
+list_t* __arena_list_new(arena_t* arena, size_t item_size);
 size_t list_size(list_t* list);
 void list_clear(list_t* list);
+void list_truncate(list_t* list, size_t size);
 void* __list_add(list_t* list);
 void* __list_get(list_t* list, size_t index);
 void list_remove(list_t* list, size_t index);
@@ -84,31 +121,42 @@ void list_delete(list_t* list);
 
 #define list(T) __DEFINE(list, __PARAM(T, _l))
 #define list_new(T) __list_new(sizeof(T))
+#define arena_list_new(arena, T) __arena_list_new(arena, sizeof(T))
 #define list_add(list) __RETURNS(list, _l, __list_add)
 #define list_get(list, index) __RETURNS(list, _l, __list_get, index)
 
 map_t* __map_new(compare_t compare, size_t key_size, size_t value_size);
+map_t* __arena_map_new(arena_t* arena, compare_t compare, size_t key_size, size_t value_size);
+map_t* __hashmap_new(hash_t hash, compare_t compare, size_t key_size, size_t value_size);
 size_t map_size(map_t* map);
 void map_clear(map_t* map);
 bool map_find(map_t* map, void* key);
 void map_index(map_t* map, size_t index);
 bool map_commit(map_t* map);
+void map_add_many(map_t* map, size_t count);
+void map_commit_many(map_t* map, size_t count);
 void* __map_add(map_t* map);
 void* __map_get_key(map_t* map);
 void* __map_get_value(map_t* map);
 void map_remove(map_t* map);
+map_t* map_copy(map_t* map);
 void map_delete(map_t* map);
 
 #define map(K, V) __DEFINE(map, __PARAM(K, _k) __PARAM(V, _v))
 #define map_new(compare, K, V) __map_new(compare, sizeof(K), sizeof(V))
+#define arena_map_new(arena, compare, K, V) __arena_map_new(arena, compare, sizeof(K), sizeof(V))
+#define hashmap_new(hash, compare, K, V) __hashmap_new(hash, compare, sizeof(K), sizeof(V))
 #define map_add(map) __RETURNS(map, _k, __map_add)
 #define map_get_key(map) __RETURNS(map, _k, __map_get_key)
 #define map_get_value(map) __RETURNS(map, _v, __map_get_value)
 
 set_t* __set_new(compare_t compare, size_t item_size);
+set_t* __hashset_new(hash_t hash, compare_t compare, size_t item_size);
 size_t set_size(set_t* set);
 void set_clear(set_t* set);
 bool set_commit(set_t* set);
+void set_add_many(set_t* set, size_t count);
+void set_commit_many(set_t* set, size_t count);
 int set_indexof(set_t* set, void* key);
 void* __set_add(set_t* set);
 void* __set_get(set_t* set, size_t index);
@@ -117,6 +165,7 @@ void set_delete(set_t* set);
 
 #define set(T) __DEFINE(set, __PARAM(T, _st))
 #define set_new(compare, T) __set_new(compare, sizeof(T))
+#define hashset_new(hash, compare, T) __hashset_new(hash, compare, sizeof(T))
 #define set_find(set, key) ({ int index = set_indexof(set, key); index == -1 ? NULL : &set_get(set, index); })
 #define set_add(set) __RETURNS(set, _st, __set_add)
 #define set_get(set, index) __RETURNS(set, _st, __set_get, index)
@@ -10,6 +10,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <threads.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #define FORMAT(fmt) ({ \
     va_list args1, args2; \
@@ -93,6 +101,52 @@ static uint64_t hash_type(jitc_type_t* type) {
     return type->hash = hash;
 }
 
+static bool jitc_streq(const char* a, const char* b) {
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+// children are already canonical, so two types are structurally equal when their own fields match
+static bool jitc_type_equals(jitc_type_t* a, jitc_type_t* b) {
+    if (a->kind != b->kind || a->size != b->size || a->alignment != b->alignment) return false;
+    if (a->is_const != b->is_const || a->is_unsigned != b->is_unsigned || !jitc_streq(a->name, b->name)) return false;
+    switch (a->kind) {
+        case Type_Pointer:
+            if (a->ptr.prev != b->ptr.prev || a->ptr.arr_size != b->ptr.arr_size) return false;
+        case Type_Enum:
+            return a->ptr.base == b->ptr.base;
+        case Type_Array:
+            return a->arr.base == b->arr.base && a->arr.size == b->arr.size;
+        case Type_Function:
+            if (a->func.ret != b->func.ret || a->func.num_params != b->func.num_params) return false;
+            for (size_t i = 0; i < a->func.num_params; i++)
+                if (a->func.params[i] != b->func.params[i]) return false;
+            return true;
+        case Type_Struct:
+        case Type_Union:
+            if (a->str.source_location.row != b->str.source_location.row || a->str.source_location.col != b->str.source_location.col) return false;
+            if (a->str.source_location.filename != b->str.source_location.filename || a->str.num_fields != b->str.num_fields) return false;
+            for (size_t i = 0; i < a->str.num_fields; i++)
+                if (a->str.fields[i] != b->str.fields[i]) return false;
+            return true;
+        case Type_StructRef:
+        case Type_UnionRef:
+            if (!a->ref.templ_types != !b->ref.templ_types) return false;
+            if (a->ref.templ_types && a->ref.templ_num_types != b->ref.templ_num_types) return false;
+            if (a->ref.templ_types) for (size_t i = 0; i < a->ref.templ_num_types; i++)
+                if (a->ref.templ_types[i] != b->ref.templ_types[i]) return false;
+        case Type_EnumRef:
+            return jitc_streq(a->ref.name, b->ref.name);
+        case Type_Placeholder:
+            return jitc_streq(a->placeholder.name, b->placeholder.name);
+        case Type_Template:
+            if (a->templ.base != b->templ.base || a->templ.num_names != b->templ.num_names) return false;
+            for (size_t i = 0; i < a->templ.num_names; i++)
+                if (!jitc_streq(a->templ.names[i], b->templ.names[i])) return false;
+            return true;
+        default: return true;
+    }
+}
+
 static void jitc_update_struct(jitc_type_t* type) {
     if (type->kind == Type_Struct) {
         size_t max_alignment = 1;
@@ -125,25 +179,49 @@ static void jitc_update_struct(jitc_type_t* type) {
     }
 }
 
-static jitc_type_t* jitc_register_type(jitc_context_t* context, jitc_type_t* type, bool free_extras) {
+static void jitc_free_extras(jitc_type_t* type) {
+    if (type->kind == Type_Struct || type->kind == Type_Union) {
+        free(type->str.fields);
+        free(type->str.offsets);
+    }
+    if (type->kind == Type_Function) free(type->func.params);
+    if (type->kind == Type_Template) free(type->templ.names);
+    if (type->kind == Type_StructRef || type->kind == Type_UnionRef) free(type->ref.templ_types);
+}
+
+static jitc_type_t* jitc_typecache_find(jitc_context_t* context, uint64_t hash) {
+    // types are shared with the parent so that imported declarations compare equal to local ones
+    for (; context; context = context->parent)
+        if (map_find(context->typecache, &hash)) return map_get_value(context->typecache);
+    return NULL;
+}
+
+static jitc_type_t* jitc_register_type(jitc_context_t* context, jitc_type_t* type, bool owns_extras) {
     uint64_t hash = hash_type(type);
-    if (!map_find(context->typecache, &hash)) {
-        jitc_type_t* copy = malloc(sizeof(jitc_type_t));
-        memcpy(copy, type, sizeof(jitc_type_t));
-        map_add(context->typecache) = hash;
-        map_commit(context->typecache);
-        map_get_value(context->typecache) = copy;
-    }
-    else if (free_extras) {
-        if (type->kind == Type_Struct || type->kind == Type_Union) {
-            free(type->str.fields);
-            free(type->str.offsets);
+    jitc_type_t* cached;
+    // colliding types are probed to the next free key, which then serves as their hash
+    while ((cached = jitc_typecache_find(context, hash)) && !jitc_type_equals(cached, type)) hash++;
+    if (cached) {
+        if (owns_extras) jitc_free_extras(type);
+        return cached;
+    }
+    jitc_type_t* copy = arena_memdup(context->arena, type, sizeof(jitc_type_t));
+    if (owns_extras) {
+        if (copy->kind == Type_Struct || copy->kind == Type_Union) {
+            copy->str.fields = arena_memdup(context->arena, type->str.fields, sizeof(jitc_type_t*) * type->str.num_fields);
+            copy->str.offsets = arena_memdup(context->arena, type->str.offsets, sizeof(size_t) * type->str.num_fields);
         }
-        if (type->kind == Type_Function) free(type->func.params);
-        if (type->kind == Type_Template) free(type->templ.names);
-        if (type->kind == Type_StructRef || type->kind == Type_UnionRef) free(type->ref.templ_types);
+        if (copy->kind == Type_Function) copy->func.params = arena_memdup(context->arena, type->func.params, sizeof(jitc_type_t*) * type->func.num_params);
+        if (copy->kind == Type_Template) copy->templ.names = arena_memdup(context->arena, type->templ.names, sizeof(char*) * type->templ.num_names);
+        if (copy->kind == Type_StructRef || copy->kind == Type_UnionRef) copy->ref.templ_types = arena_memdup(context->arena, type->ref.templ_types, sizeof(jitc_type_t*) * type->ref.templ_num_types);
+        jitc_free_extras(type);
     }
-    return map_get_value(context->typecache);
+    copy->hash = hash;
+    map_add(context->typecache) = hash;
+    map_commit(context->typecache);
+    map_get_value(context->typecache) = copy;
+    copy->unnamed = copy->name ? jitc_typecache_named(context, copy, NULL) : copy;
+    return copy;
 }
 
 static jitc_type_t jitc_copy_type(jitc_type_t* type) {
@@ -182,21 +260,21 @@ jitc_type_t* jitc_typecache_primitive(jitc_context_t* context, jitc_type_kind_t
 }
 
 jitc_type_t* jitc_typecache_unsigned(jitc_context_t* context, jitc_type_t* base) {
-    jitc_type_t type = jitc_copy_type(base);
+    jitc_type_t type = *base;
     type.is_unsigned = true;
     type.hash = 0;
     return jitc_register_type(context, &type, false);
 }
 
 jitc_type_t* jitc_typecache_const(jitc_context_t* context, jitc_type_t* base) {
-    jitc_type_t type = jitc_copy_type(base);
+    jitc_type_t type = *base;
     type.is_const = true;
     type.hash = 0;
     return jitc_register_type(context, &type, false);
 }
 
 jitc_type_t* jitc_typecache_align(jitc_context_t* context, jitc_type_t* base, uint64_t new_align) {
-    jitc_type_t type = jitc_copy_type(base);
+    jitc_type_t type = *base;
     type.alignment = new_align;
     type.hash = 0;
     return jitc_register_type(context, &type, false);
@@ -205,7 +283,7 @@ jitc_type_t* jitc_typecache_align(jitc_context_t* context, jitc_type_t* base, ui
 jitc_type_t* jitc_typecache_pointer(jitc_context_t* context, jitc_type_t* base) {
     jitc_type_t ptr = {};
     if (base->kind == Type_Pointer && base->ptr.prev != Type_Pointer) {
-        ptr = jitc_copy_type(base);
+        ptr = *base;
         ptr.ptr.prev = Type_Pointer;
         ptr.hash = 0;
         return jitc_register_type(context, &ptr, false);
@@ -246,7 +324,7 @@ jitc_type_t* jitc_typecache_struct(jitc_context_t* context, list_t* _fields, jit
     str.str.num_fields = list_size(fields);
     str.str.fields = malloc(sizeof(jitc_type_t*) * list_size(fields));
     str.str.offsets = malloc(sizeof(size_t) * list_size(fields));
-    str.str.source_location = source->locations[0];
+    str.str.source_location = (jitc_source_location_t){ .row = source->row, .col = source->col, .filename = source->filename };
     for (size_t i = 0; i < list_size(fields); i++) str.str.fields[i] = list_get(fields, i);
     jitc_update_struct(&str);
     return jitc_register_type(context, &str, true);
@@ -259,7 +337,7 @@ jitc_type_t* jitc_typecache_union(jitc_context_t* context, list_t* _fields, jitc
     str.str.num_fields = list_size(fields);
     str.str.fields = malloc(sizeof(jitc_type_t*) * list_size(fields));
     str.str.offsets = malloc(sizeof(size_t) * list_size(fields));
-    str.str.source_location = source->locations[0];
+    str.str.source_location = (jitc_source_location_t){ .row = source->row, .col = source->col, .filename = source->filename };
     for (size_t i = 0; i < list_size(fields); i++) str.str.fields[i] = list_get(fields, i);
     jitc_update_struct(&str);
     return jitc_register_type(context, &str, true);
@@ -284,7 +362,7 @@ jitc_type_t* jitc_typecache_structref(jitc_context_t* context, const char* name,
     if (template_list) for (int i = 0; i < ref.ref.templ_num_types; i++) {
         ref.ref.templ_types[i] = list_get(template_list, i);
     }
-    return jitc_register_type(context, &ref, false);
+    return jitc_register_type(context, &ref, true);
 }
 
 jitc_type_t* jitc_typecache_unionref(jitc_context_t* context, const char* name, list_t* _template_list) {
@@ -297,7 +375,7 @@ jitc_type_t* jitc_typecache_unionref(jitc_context_t* context, const char* name,
     if (template_list) for (int i = 0; i < ref.ref.templ_num_types; i++) {
         ref.ref.templ_types[i] = list_get(template_list, i);
     }
-    return jitc_register_type(context, &ref, false);
+    return jitc_register_type(context, &ref, true);
 }
 
 jitc_type_t* jitc_typecache_enumref(jitc_context_t* context, const char* name) {
@@ -322,7 +400,7 @@ jitc_type_t* jitc_typecache_template(jitc_context_t* context, jitc_type_t* base,
     templ.templ.base = base;
     templ.templ.num_names = list_size(names);
     templ.templ.names = malloc(sizeof(char*) * templ.templ.num_names);
-    templ.templ.source = source;
+    templ.templ.source = arena_memdup(context->arena, source, sizeof(jitc_token_t));
     templ.alignment = base->alignment;
     templ.size = base->size;
     for (int i = 0; i < templ.templ.num_names; i++) {
@@ -331,7 +409,7 @@ jitc_type_t* jitc_typecache_template(jitc_context_t* context, jitc_type_t* base,
     return jitc_register_type(context, &templ, true);
 }
 
-#define throw_impl(...) jitc_error_set(context, jitc_error_parser(base->templ.source, __VA_ARGS__))
+#define throw_impl(...) jitc_error_set(context, jitc_error_parser(context, base->templ.source, __VA_ARGS__))
 
 jitc_type_t* jitc_typecache_fill_template(jitc_context_t* context, jitc_type_t* base, map_t* _mappings) {
     map(char*, jitc_type_t*)* mappings = _mappings;
@@ -379,7 +457,7 @@ jitc_type_t* jitc_typecache_fill_template(jitc_context_t* context, jitc_type_t*
 #undef throw_impl
 
 jitc_type_t* jitc_typecache_named(jitc_context_t* context, jitc_type_t* base, const char* name) {
-    jitc_type_t type = jitc_copy_type(base);
+    jitc_type_t type = *base;
     type.name = name;
     type.hash = 0;
     return jitc_register_type(context, &type, false);
@@ -404,7 +482,7 @@ bool jitc_typecmp(jitc_context_t* context, jitc_type_t* a, jitc_type_t* b) {
         a = jitc_get_tagged_type(context, a) ?: a;
     if (b->kind == Type_StructRef || b->kind == Type_UnionRef || b->kind == Type_EnumRef)
         b = jitc_get_tagged_type(context, b) ?: b;
-    return jitc_typecache_named(context, a, NULL) == jitc_typecache_named(context, b, NULL);
+    return a->unnamed == b->unnamed;
 }
 
 jitc_type_t* jitc_to_method(jitc_context_t* context, jitc_type_t* type) {
@@ -415,7 +493,7 @@ jitc_type_t* jitc_to_method(jitc_context_t* context, jitc_type_t* type) {
         func->func.params[0]->kind == Type_Pointer &&
         strcmp(func->func.params[0]->name, "this") == 0
     ) {
-        uint64_t hash = jitc_typecache_named(context, func->func.params[0]->ptr.base, NULL)->hash;
+        uint64_t hash = func->func.params[0]->ptr.base->unnamed->hash;
         char new_name[2 + 16 + strlen(type->name) + 1];
         sprintf(new_name, "@m%016lx%s", hash, type->name);
         type = jitc_typecache_named(context, type, jitc_append_string(context, new_name));
@@ -423,12 +501,74 @@ jitc_type_t* jitc_to_method(jitc_context_t* context, jitc_type_t* type) {
     return type;
 }
 
+static uint64_t jitc_method_receiver(jitc_context_t* context, jitc_type_t* type) {
+    if (type->kind == Type_StructRef || type->kind == Type_UnionRef || type->kind == Type_EnumRef)
+        type = jitc_get_tagged_type(context, type) ?: type;
+    return type->unnamed->hash;
+}
+
+static void jitc_index_method(jitc_context_t* context, jitc_scope_t* scope, jitc_variable_t* var) {
+    jitc_type_t* func = var->type->kind == Type_Template ? var->type->templ.base : var->type;
+    jitc_method_key_t key = {
+        jitc_append_string(context, var->type->name + 18),
+        var->type->kind == Type_Template ? 0 : jitc_method_receiver(context, func->func.params[0]->ptr.base)
+    };
+    // template receivers depend on the template arguments, so they are chained under their name alone
+    if (map_find(scope->methods, &key)) var->next_method = map_get_value(scope->methods);
+    else {
+        map_add(scope->methods) = key;
+        map_commit(scope->methods);
+    }
+    map_get_value(scope->methods) = var;
+}
+
+static jitc_variable_t* jitc_get_imported_variable(jitc_context_t* context, const char* name) {
+    for (size_t i = list_size(context->imports) - 1; i < list_size(context->imports) /* rely on underflow */; i--) {
+        jitc_scope_t* scope = list_get(context->imports, i);
+        if (map_find(scope->variables, &name)) return map_get_value(scope->variables);
+    }
+    return NULL;
+}
+
+static jitc_binding_t* jitc_get_binding(map_t* _table, const char* name) {
+    map(char*, jitc_binding_t*)* table = _table;
+    return map_find(table, &name) ? map_get_value(table) : NULL;
+}
+
+// block scopes share one table per namespace, every binding hides the one it shadows until its scope is popped
+static void jitc_bind(jitc_context_t* context, map_t* _table, const char* name, void* value) {
+    map(char*, jitc_binding_t*)* table = _table;
+    size_t depth = list_size(context->scopes) - 1;
+    jitc_binding_t* shadowed = jitc_get_binding(table, name);
+    if (shadowed && shadowed->depth == depth) {
+        shadowed->value = value;
+        return;
+    }
+    jitc_binding_t* binding = arena_alloc(context->parse_arena, sizeof(jitc_binding_t));
+    *binding = (jitc_binding_t){ value, depth, shadowed };
+    if (!shadowed) {
+        map_add(table) = (char*)name;
+        map_commit(table);
+    }
+    map_get_value(table) = binding;
+    list_add(context->undo_log) = (jitc_undo_t){ table, name };
+}
+
 bool jitc_declare_variable(jitc_context_t* context, jitc_type_t* type, jitc_decltype_t decltype, const char* extern_symbol, jitc_preserve_t preserve_policy, uint64_t value) {
     if (!type->name) return true;
     if (*type->name == '$') type = jitc_typecache_named(context, type, type->name + 9);
-    jitc_scope_t* scope = &list_get(context->scopes, decltype == Decltype_Static ? 0 : list_size(context->scopes) - 1);
+    bool global = decltype == Decltype_Static || list_size(context->scopes) == 1;
+    jitc_scope_t* scope = &list_get(context->scopes, global ? 0 : list_size(context->scopes) - 1);
     jitc_variable_t* prev = NULL;
-    if (map_find(scope->variables, &type->name)) prev = map_get_value(scope->variables);
+    if (!global) {
+        jitc_binding_t* binding = jitc_get_binding(context->local_variables, type->name);
+        if (binding && binding->depth == list_size(context->scopes) - 1) prev = binding->value;
+    }
+    else if (map_find(scope->variables, &type->name)) prev = map_get_value(scope->variables);
+    else {
+        jitc_variable_t* imported = jitc_get_imported_variable(context, type->name);
+        if (imported && !jitc_typecmp(context, imported->type, type)) return false;
+    }
     uint32_t scope_id = decltype == Decltype_Argument ? 0 : scope->scope_id;
     if (decltype == Decltype_Argument) decltype = Decltype_None;
     if (prev) {
@@ -454,6 +594,8 @@ bool jitc_declare_variable(jitc_context_t* context, jitc_type_t* type, jitc_decl
         if (!jitc_typecmp(context, prev->type, type)) preserve_policy = Preserve_Never; // todo: add compatible merges
         if (prev->decltype != decltype) preserve_policy = Preserve_Never;
         if (preserve_policy == Preserve_Never) {
+            // a linked prototype holds the resolved symbol, not storage or a trampoline of its own
+            if (prev->decltype == Decltype_Extern && decltype != Decltype_Extern) prev->ptr = NULL;
             prev->type = type;
             prev->decltype = decltype;
             if (decltype == Decltype_EnumItem) prev->enum_value = value;
@@ -461,10 +603,7 @@ bool jitc_declare_variable(jitc_context_t* context, jitc_type_t* type, jitc_decl
         prev->preserve_policy = policy_ifconst ? Preserve_IfConst : preserve_policy;
         return true;
     }
-    bool global = scope == &list_get(context->scopes, 0);
-    map_add(scope->variables) = (char*)type->name;
-    map_commit(scope->variables);
-    jitc_variable_t* var = malloc(sizeof(jitc_variable_t));
+    jitc_variable_t* var = arena_alloc(global ? context->arena : context->parse_arena, sizeof(jitc_variable_t));
     var->type = type;
     var->extern_symbol = extern_symbol;
     var->decltype = decltype;
@@ -472,19 +611,41 @@ bool jitc_declare_variable(jitc_context_t* context, jitc_type_t* type, jitc_decl
     var->preserve_policy = preserve_policy;
     var->initial = true;
     var->scope_id = scope_id;
+    var->next_method = NULL;
+    if (!global) {
+        jitc_bind(context, context->local_variables, type->name, var);
+        return true;
+    }
+    map_add(scope->variables) = (char*)type->name;
+    map_commit(scope->variables);
     map_get_value(scope->variables) = var;
+    if (strncmp(type->name, "@m", 2) == 0) jitc_index_method(context, scope, var);
     return true;
 }
 
+static map_t* jitc_scope_tags(jitc_scope_t* scope, jitc_type_kind_t kind) {
+    if (kind == Type_StructRef || kind == Type_Struct) return scope->structs;
+    if (kind == Type_UnionRef || kind == Type_Union) return scope->unions;
+    if (kind == Type_EnumRef || kind == Type_Enum) return scope->enums;
+    return NULL;
+}
+
+static map_t* jitc_local_tags(jitc_context_t* context, jitc_type_kind_t kind) {
+    if (kind == Type_StructRef || kind == Type_Struct) return context->local_structs;
+    if (kind == Type_UnionRef || kind == Type_Union) return context->local_unions;
+    if (kind == Type_EnumRef || kind == Type_Enum) return context->local_enums;
+    return NULL;
+}
+
 bool jitc_declare_tagged_type(jitc_context_t* context, jitc_type_t* type, const char* name) {
-    jitc_scope_t* scope = &list_get(context->scopes, list_size(context->scopes) - 1);
-    map(char*, jitc_type_t*)* map = NULL;
     jitc_type_kind_t kind = type->kind;
     if (kind == Type_Template) kind = type->templ.base->kind;
-    if (kind == Type_Struct) map = (void*)scope->structs;
-    if (kind == Type_Union) map = (void*)scope->unions;
-    if (kind == Type_Enum) map = (void*)scope->enums;
-    if (!map) return false;
+    if (kind != Type_Struct && kind != Type_Union && kind != Type_Enum) return false;
+    if (list_size(context->scopes) > 1) {
+        jitc_bind(context, jitc_local_tags(context, kind), name, type);
+        return true;
+    }
+    map(char*, jitc_type_t*)* map = jitc_scope_tags(&list_get(context->scopes, 0), kind);
     if (!map_find(map, &name)) {
         map_add(map) = (char*)name;
         map_commit(map);
@@ -496,26 +657,24 @@ bool jitc_declare_tagged_type(jitc_context_t* context, jitc_type_t* type, const
 jitc_variable_t* jitc_get_variable(jitc_context_t* context, const char* name) {
     if (!name) return NULL;
     if (*name == '$') name += 9;
-    bool outside_of_function = false;
-    for (size_t i = list_size(context->scopes) - 1; i < list_size(context->scopes) /* rely on underflow */; i--) {
-        if (i != 0 && outside_of_function) continue;
-        jitc_scope_t* scope = &list_get(context->scopes, i);
-        if (scope->func) outside_of_function = true;
-        if (!map_find(scope->variables, &name)) continue;
-        return map_get_value(scope->variables);
-    }
-    return NULL;
+    // locals of enclosing functions are out of reach, shadowed bindings are always declared further out
+    jitc_binding_t* binding = jitc_get_binding(context->local_variables, name);
+    if (binding && binding->depth >= list_get(context->scopes, list_size(context->scopes) - 1).func_depth) return binding->value;
+    jitc_scope_t* global = &list_get(context->scopes, 0);
+    if (map_find(global->variables, &name)) return map_get_value(global->variables);
+    return jitc_get_imported_variable(context, name);
 }
 
 jitc_type_t* jitc_get_tagged_type_notype(jitc_context_t* context, jitc_type_kind_t kind, const char* name) {
     if (!name) return NULL;
-    for (size_t i = list_size(context->scopes) - 1; i < list_size(context->scopes) /* rely on underflow */; i--) {
-        jitc_scope_t* scope = &list_get(context->scopes, i);
-        map(char*, jitc_type_t*)* map = NULL;
-        if (kind == Type_StructRef || kind == Type_Struct) map = (void*)scope->structs;
-        if (kind == Type_UnionRef || kind == Type_Union) map = (void*)scope->unions;
-        if (kind == Type_EnumRef || kind == Type_Enum) map = (void*)scope->enums;
-        if (!map) return NULL;
+    map_t* locals = jitc_local_tags(context, kind);
+    if (!locals) return NULL;
+    jitc_binding_t* binding = jitc_get_binding(locals, name);
+    if (binding) return binding->value;
+    map(char*, jitc_type_t*)* map = jitc_scope_tags(&list_get(context->scopes, 0), kind);
+    if (map_find(map, &name)) return map_get_value(map);
+    for (size_t i = list_size(context->imports) - 1; i < list_size(context->imports); i--) {
+        map(char*, jitc_type_t*)* map = jitc_scope_tags(list_get(context->imports, i), kind);
         if (!map_find(map, &name)) continue;
         return map_get_value(map);
     }
@@ -537,38 +696,76 @@ jitc_type_t* jitc_get_tagged_type(jitc_context_t* context, jitc_type_t* type) {
     return tagged;
 }
 
+static uint64_t hash_method_key(const void* key) {
+    const jitc_method_key_t* method = key;
+    return hash_mix(hash_ptr((void*)method->name), method->receiver);
+}
+
+static int compare_method_key(const void* a, const void* b) {
+    const jitc_method_key_t* x = a;
+    const jitc_method_key_t* y = b;
+    if (x->name != y->name) return x->name < y->name ? -1 : 1;
+    return (x->receiver > y->receiver) - (x->receiver < y->receiver);
+}
+
+// arguments are canonical types, so instances compare by pointer
+static uint64_t hash_instance_key(const void* key) {
+    const jitc_instance_key_t* instance = key;
+    uint64_t hash = hash_ptr(instance->templ);
+    for (size_t i = 0; i < instance->num_args; i++) hash = hash_mix(hash, hash_ptr(instance->args[i]));
+    return hash;
+}
+
+static int compare_instance_key(const void* a, const void* b) {
+    const jitc_instance_key_t* x = a;
+    const jitc_instance_key_t* y = b;
+    if (x->templ != y->templ) return x->templ < y->templ ? -1 : 1;
+    if (x->num_args != y->num_args) return x->num_args < y->num_args ? -1 : 1;
+    for (size_t i = 0; i < x->num_args; i++)
+        if (x->args[i] != y->args[i]) return x->args[i] < y->args[i] ? -1 : 1;
+    return 0;
+}
+
 void jitc_push_scope(jitc_context_t* context) {
     static uint32_t id = 0;
     jitc_scope_t* scope = &list_add(context->scopes);
-    scope->variables = map_new(compare_string, char*, jitc_variable_t);
-    scope->structs = map_new(compare_string, char*, jitc_type_t*);
-    scope->unions = map_new(compare_string, char*, jitc_type_t*);
-    scope->enums = map_new(compare_string, char*, jitc_type_t*);
-    scope->func = false;
-    scope->scope_id = list_size(context->scopes) == 1 ? 0 : ++id;
+    *scope = (jitc_scope_t){ .undo_mark = list_size(context->undo_log) };
+    if (list_size(context->scopes) > 1) {
+        scope->func_depth = list_get(context->scopes, list_size(context->scopes) - 2).func_depth;
+        scope->scope_id = ++id;
+        return;
+    }
+    scope->variables = hashmap_new(hash_string, compare_string, char*, jitc_variable_t*);
+    scope->structs = hashmap_new(hash_string, compare_string, char*, jitc_type_t*);
+    scope->unions = hashmap_new(hash_string, compare_string, char*, jitc_type_t*);
+    scope->enums = hashmap_new(hash_string, compare_string, char*, jitc_type_t*);
+    scope->methods = hashmap_new(hash_method_key, compare_method_key, jitc_method_key_t, jitc_variable_t*);
 }
 
 void jitc_push_function(jitc_context_t* context) {
     jitc_push_scope(context);
-    list_get(context->scopes, list_size(context->scopes) - 1).func = true;
+    list_get(context->scopes, list_size(context->scopes) - 1).func_depth = list_size(context->scopes) - 1;
 }
 
 static void jitc_destroy_scope(jitc_scope_t* scope) {
-    for (size_t i = 0; i < map_size(scope->variables); i++) {
-        map_index(scope->variables, i);
-        free(map_get_value(scope->variables));
-    }
     map_delete(scope->variables);
     map_delete(scope->structs);
     map_delete(scope->unions);
     map_delete(scope->enums);
+    map_delete(scope->methods);
 }
 
 bool jitc_pop_scope(jitc_context_t* context) {
     if (list_size(context->scopes) <= 1) return false;
-    jitc_scope_t* scope = &list_get(context->scopes, list_size(context->scopes) - 1);
+    size_t undo_mark = list_get(context->scopes, list_size(context->scopes) - 1).undo_mark;
     list_remove(context->scopes, list_size(context->scopes) - 1);
-    jitc_destroy_scope(scope);
+    while (list_size(context->undo_log) > undo_mark) {
+        jitc_undo_t undo = list_get(context->undo_log, list_size(context->undo_log) - 1);
+        list_remove(context->undo_log, list_size(context->undo_log) - 1);
+        map(char*, jitc_binding_t*)* table = (void*)undo.table;
+        map_find(table, &undo.name);
+        map_get_value(table) = map_get_value(table)->shadowed;
+    }
     return true;
 }
 
@@ -582,11 +779,21 @@ jitc_error_t* jitc_error_syntax(const char* filename, int row, int col, const ch
     return error;
 }
 
-jitc_error_t* jitc_error_parser(jitc_token_t* token, const char* str, ...) {
+jitc_error_t* jitc_error_parser(jitc_context_t* context, jitc_token_t* token, const char* str, ...) {
     jitc_error_t* error = malloc(sizeof(jitc_error_t));
     error->msg = FORMAT(str);
-    error->num_locations = token->num_locations;
-    memcpy(error->locations, token->locations, sizeof(error->locations));
+    error->num_locations = 1;
+    error->file = token ? token->filename : NULL;
+    error->row = token ? token->row : 0;
+    error->col = token ? token->col : 0;
+    if (!token) return error;
+    size_t depth = 0;
+    for (uint32_t i = token->expansion; i != 0; i = list_get(context->expansions, i).parent) depth++;
+    uint32_t chain[depth + 1];
+    depth = 0;
+    for (uint32_t i = token->expansion; i != 0; i = list_get(context->expansions, i).parent) chain[depth++] = i;
+    while (depth > 0 && error->num_locations < JITC_LOCATION_DEPTH)
+        error->locations[error->num_locations++] = list_get(context->expansions, chain[--depth]).location;
     return error;
 }
 
@@ -617,13 +824,45 @@ void jitc_error_set(jitc_context_t* context, jitc_error_t* error) {
     context->error = error;
 }
 
-void jitc_push_location(jitc_token_t* token, const char* filename, int row, int col) {
-    if (token->num_locations == 0) abort();
-    if (token->num_locations == JITC_LOCATION_DEPTH) return;
-    jitc_source_location_t* location = &token->locations[token->num_locations++];
-    location->filename = filename;
-    location->row = row;
-    location->col = col;
+static uint64_t hash_expansion(const void* key) {
+    const jitc_expansion_t* expansion = key;
+    uint64_t hash = hash_ptr((void*)expansion->location.filename);
+    hash = hash_mix(hash, hash_int(expansion->location.row));
+    hash = hash_mix(hash, hash_int(expansion->location.col));
+    hash = hash_mix(hash, hash_int(expansion->parent));
+    return hash;
+}
+
+static int compare_expansion(const void* a, const void* b) {
+    const jitc_expansion_t* x = a;
+    const jitc_expansion_t* y = b;
+    if (x->location.filename != y->location.filename) return x->location.filename < y->location.filename ? -1 : 1;
+    if (x->location.row != y->location.row) return x->location.row - y->location.row;
+    if (x->location.col != y->location.col) return x->location.col - y->location.col;
+    return (x->parent > y->parent) - (x->parent < y->parent);
+}
+
+uint32_t jitc_add_expansion(jitc_context_t* context, uint32_t parent, const char* filename, int row, int col) {
+    jitc_expansion_t expansion = {
+        .location = { .row = row, .col = col, .filename = filename },
+        .parent = parent,
+    };
+    map_add(context->expansion_index) = expansion;
+    if (map_commit(context->expansion_index)) {
+        map_get_value(context->expansion_index) = list_size(context->expansions);
+        list_add(context->expansions) = expansion;
+    }
+    return map_get_value(context->expansion_index);
+}
+
+void jitc_push_location(jitc_context_t* context, jitc_token_t* token, const char* filename, int row, int col) {
+    token->expansion = jitc_add_expansion(context, token->expansion, filename, row, col);
+}
+
+const char* jitc_token_root_file(jitc_context_t* context, jitc_token_t* token) {
+    // the chain starts at the last pushed location, which is in the outermost file
+    if (token->expansion == 0) return token->filename;
+    return list_get(context->expansions, token->expansion).location.filename;
 }
 
 bool jitc_validate_type(jitc_type_t* type, jitc_type_policy_t policy) {
@@ -638,12 +877,11 @@ bool jitc_validate_type(jitc_type_t* type, jitc_type_policy_t policy) {
 
 char* jitc_append_string(jitc_context_t* context, const char* str) {
     if (!str) return NULL;
-    char** ptr = set_find(context->strings, &str);
-    if (ptr) return *ptr;
-    char* string = strdup(str);
-    set_add(context->strings) = string;
-    set_commit(context->strings);
-    return string;
+    return (char*)interner_add(context->strings, str, strlen(str));
+}
+
+char* jitc_append_string_n(jitc_context_t* context, const char* str, size_t length) {
+    return (char*)interner_add(context->strings, str, length);
 }
 
 static const char header_ctype[] = {
@@ -706,37 +944,274 @@ static const char header_time[] = {
     ,0
 };
 
-jitc_context_t* jitc_create_context() {
+static jitc_context_t* jitc_new_context() {
     jitc_context_t* context = malloc(sizeof(jitc_context_t));
-    context->strings = set_new(compare_string, char*);
-    context->typecache = map_new(compare_int64, char*, jitc_type_t);
-    context->headers = map_new(compare_string, char*, char*);
+    context->arena = arena_new(65536);
+    context->parse_arena = arena_new(65536);
+    context->embed_arena = arena_new(65536);
+    context->strings = interner_new();
+    context->expansions = list_new(jitc_expansion_t);
+    context->expansion_index = hashmap_new(hash_expansion, compare_expansion, jitc_expansion_t, uint32_t);
+    list_add(context->expansions) = (jitc_expansion_t){};
+    context->typecache = hashmap_new(hash_int64, compare_int64, uint64_t, jitc_type_t*);
+    context->instances = hashmap_new(hash_instance_key, compare_instance_key, jitc_instance_key_t, jitc_type_t*);
+    context->headers = map_new(compare_string, char*, jitc_header_t);
+    context->header_cache = hashmap_new(hash_int64, compare_int64, const char*, jitc_cached_header_t);
+    context->prelude = NULL;
+    context->prelude_pending = false;
+    context->parent = NULL;
+    context->snapshot = NULL;
+    context->imports = list_new(jitc_scope_t*);
+    context->refcount = 1;
+    context->cache_dir = NULL;
+    context->recording = NULL;
+    context->vfs = jitc_vfs_new();
     context->tasks = map_new(compare_string, char*, jitc_build_task_t);
     context->labels = list_new(char*);
     context->scopes = list_new(jitc_scope_t);
+    context->local_variables = hashmap_new(hash_string, compare_string, char*, jitc_binding_t*);
+    context->local_structs = hashmap_new(hash_string, compare_string, char*, jitc_binding_t*);
+    context->local_unions = hashmap_new(hash_string, compare_string, char*, jitc_binding_t*);
+    context->local_enums = hashmap_new(hash_string, compare_string, char*, jitc_binding_t*);
+    context->undo_log = list_new(jitc_undo_t);
     context->memchunks = list_new(jitc_memchunk_t);
     context->instantiation_requests = queue_new(jitc_instantiation_request_t);
     context->error = NULL;
+    context->unresolved_symbol = NULL;
     jitc_push_scope(context);
-    jitc_create_header(context, "ctype.h", header_ctype);
-    jitc_create_header(context, "errno.h", header_errno);
-    jitc_create_header(context, "limits.h", header_limits);
-    jitc_create_header(context, "math.h", header_math);
-    jitc_create_header(context, "stdarg.h", header_stdarg);
-    jitc_create_header(context, "stdbool.h", header_stdbool);
-    jitc_create_header(context, "stddef.h", header_stddef);
-    jitc_create_header(context, "stdint.h", header_stdint);
-    jitc_create_header(context, "stdio.h", header_stdio);
-    jitc_create_header(context, "stdlib.h", header_stdlib);
-    jitc_create_header(context, "string.h", header_string);
-    jitc_create_header(context, "time.h", header_time);
+    return context;
+}
+
+static struct {
+    const char* name;
+    jitc_header_t header;
+} builtin_headers[] = {
+    { "ctype.h", { (char*)header_ctype, sizeof(header_ctype) - 1 } },
+    { "errno.h", { (char*)header_errno, sizeof(header_errno) - 1 } },
+    { "limits.h", { (char*)header_limits, sizeof(header_limits) - 1 } },
+    { "math.h", { (char*)header_math, sizeof(header_math) - 1 } },
+    { "stdarg.h", { (char*)header_stdarg, sizeof(header_stdarg) - 1 } },
+    { "stdbool.h", { (char*)header_stdbool, sizeof(header_stdbool) - 1 } },
+    { "stddef.h", { (char*)header_stddef, sizeof(header_stddef) - 1 } },
+    { "stdint.h", { (char*)header_stdint, sizeof(header_stdint) - 1 } },
+    { "stdio.h", { (char*)header_stdio, sizeof(header_stdio) - 1 } },
+    { "stdlib.h", { (char*)header_stdlib, sizeof(header_stdlib) - 1 } },
+    { "string.h", { (char*)header_string, sizeof(header_string) - 1 } },
+    { "time.h", { (char*)header_time, sizeof(header_time) - 1 } },
+};
+
+__attribute__((constructor))
+static void builtin_headers_init() {
+    for (size_t i = 0; i < sizeof(builtin_headers) / sizeof(*builtin_headers); i++)
+        builtin_headers[i].header.hash = hash_bytes(builtin_headers[i].header.content, builtin_headers[i].header.length);
+}
+
+static jitc_header_t* jitc_find_header(jitc_context_t* context, const char* name) {
+    if (map_find(context->headers, &name)) return &map_get_value(context->headers);
+    for (size_t i = 0; i < sizeof(builtin_headers) / sizeof(*builtin_headers); i++)
+        if (strcmp(builtin_headers[i].name, name) == 0) return &builtin_headers[i].header;
+    return NULL;
+}
+
+static bool jitc_parse_macros(jitc_context_t* context, const char* code, size_t length, const char* filename, map_t* macros);
+
+static jitc_prelude_t* jitc_build_prelude() {
+    jitc_context_t* context = jitc_new_context();
+    jitc_prelude_t* prelude = malloc(sizeof(jitc_prelude_t));
+    prelude->context = context;
+    prelude->headers = map_new(compare_string, char*, jitc_prelude_header_t);
+    for (size_t i = 0; i < sizeof(builtin_headers) / sizeof(*builtin_headers); i++) {
+        char* name = jitc_append_string(context, builtin_headers[i].name);
+        jitc_header_key_t key = { name, builtin_headers[i].header.hash };
+        smartptr(string_t) code = str_new();
+        str_appendf(code, "#include \"%s\"\n", name);
+        map_t* macros = jitc_macro_table();
+        bool success = jitc_parse_macros(context, str_data(code), str_length(code), "<prelude>", macros);
+        const char* guard = map_find(context->header_cache, &key.name) ? map_get_value(context->header_cache).guard : NULL;
+        jitc_scope_t scope = list_get(context->scopes, 0);
+        list_remove(context->scopes, 0);
+        jitc_push_scope(context);
+        if (!success || !guard || context->unresolved_symbol) {
+            jitc_destroy_error(jitc_get_error(context));
+            jitc_destroy_scope(&scope);
+            jitc_delete_macro_table(macros);
+            continue;
+        }
+        map_add(prelude->headers) = name;
+        map_commit(prelude->headers);
+        map_get_value(prelude->headers) = (jitc_prelude_header_t){ macros, NULL, scope, guard, key.hash };
+    }
+    // every builtin header is guarded, so the guards in a snapshot tell which headers went into it
+    for (size_t i = 0; i < map_size(prelude->headers); i++) {
+        map_index(prelude->headers, i);
+        jitc_prelude_header_t* header = &map_get_value(prelude->headers);
+        header->words = hashset_new(hash_string, compare_string, char*);
+        for (size_t j = 0; j < map_size(context->header_cache); j++) {
+            map_index(context->header_cache, j);
+            jitc_cached_header_t* cached = &map_get_value(context->header_cache);
+            if (cached->guard && map_find(header->macros, &cached->guard)) jitc_collect_words(header->words, cached->tokens);
+        }
+    }
+    return prelude;
+}
+
+static jitc_prelude_t* builtin_prelude = NULL;
+static once_flag prelude_once = ONCE_FLAG_INIT;
+
+static void jitc_init_prelude() {
+    if (getenv("JITC_NO_PRELUDE")) return;
+    builtin_prelude = jitc_build_prelude();
+    // the prelude context frees the snapshots once the last context importing them is gone
+    builtin_prelude->context->prelude = builtin_prelude;
+}
+
+__attribute__((destructor))
+static void jitc_release_prelude() {
+    if (builtin_prelude) jitc_destroy_context(builtin_prelude->context);
+    builtin_prelude = NULL;
+}
+
+static void jitc_destroy_prelude(jitc_prelude_t* prelude) {
+    for (size_t i = 0; i < map_size(prelude->headers); i++) {
+        map_index(prelude->headers, i);
+        jitc_prelude_header_t* header = &map_get_value(prelude->headers);
+        jitc_delete_macro_table(header->macros);
+        set_delete(header->words);
+        jitc_destroy_scope(&header->scope);
+    }
+    map_delete(prelude->headers);
+    free(prelude);
+}
+
+static jitc_prelude_t* jitc_get_prelude(jitc_context_t* context) {
+    if (!context->prelude_pending) return context->prelude;
+    context->prelude_pending = false;
+    // types built before the prelude is attached wouldn't be shared with its declarations
+    if (map_size(context->typecache) > 0) return NULL;
+    call_once(&prelude_once, jitc_init_prelude);
+    if (!builtin_prelude) return NULL;
+    context->prelude = builtin_prelude;
+    context->parent = builtin_prelude->context;
+    context->parent->refcount++;
+    return builtin_prelude;
+}
+
+jitc_context_t* jitc_create_context() {
+    jitc_context_t* context = jitc_new_context();
+    // the prelude is built and attached on the first include of a builtin header
+    context->prelude_pending = true;
+    return context;
+}
+
+jitc_context_t* jitc_clone_context(jitc_context_t* source) {
+    jitc_context_t* context = jitc_new_context();
+    for (size_t i = 0; i < map_size(source->headers); i++) {
+        map_index(source->headers, i);
+        jitc_header_t header = map_get_value(source->headers);
+        header.content = memcpy(malloc(header.length + 1), header.content, header.length + 1);
+        map_add(context->headers) = map_get_key(source->headers);
+        map_commit(context->headers);
+        map_get_value(context->headers) = header;
+    }
+    // the source keeps writing to its own global scope, so the clone imports a frozen copy of its index
+    jitc_scope_t* global = &list_get(source->scopes, 0);
+    jitc_scope_t* scopes[] = { global, source->snapshot };
+    size_t num_scopes = source->snapshot ? 2 : 1;
+    context->snapshot = malloc(sizeof(jitc_scope_t));
+    *context->snapshot = (jitc_scope_t){
+        .variables = hashmap_new(hash_string, compare_string, char*, jitc_variable_t*),
+        .structs = map_copy(global->structs),
+        .unions = map_copy(global->unions),
+        .enums = map_copy(global->enums),
+        .methods = hashmap_new(hash_method_key, compare_method_key, jitc_method_key_t, jitc_variable_t*),
+    };
+    // every global gets private storage, and code compiled before the fork is copied and pointed at it
+    smartptr(map(jitc_variable_t*, jitc_variable_t*)) copies = hashmap_new(hash_int64, compare_int64, jitc_variable_t*, jitc_variable_t*);
+    smartptr(map(void*, void*)) storage = hashmap_new(hash_int64, compare_int64, void*, void*);
+    for (size_t i = 0; i < num_scopes; i++) {
+        for (size_t j = 0; j < map_size(scopes[i]->variables); j++) {
+            map_index(scopes[i]->variables, j);
+            jitc_variable_t* var = map_get_value(scopes[i]->variables);
+            jitc_variable_t* copy = arena_memdup(context->arena, var, sizeof(jitc_variable_t));
+            map_add(copies) = var;
+            map_commit(copies);
+            map_get_value(copies) = copy;
+            map_add(context->snapshot->variables) = map_get_key(scopes[i]->variables);
+            if (map_commit(context->snapshot->variables)) map_get_value(context->snapshot->variables) = copy;
+            bool defined = var->decltype == Decltype_None || var->decltype == Decltype_Static;
+            if (!defined || !var->ptr || var->type->kind == Type_Function) continue;
+            copy->ptr = arena_memdup(context->arena, var->ptr, var->type->size);
+            map_add(storage) = var->ptr;
+            map_commit(storage);
+            map_get_value(storage) = copy->ptr;
+        }
+    }
+    for (size_t i = 0; i < map_size(copies); i++) {
+        map_index(copies, i);
+        jitc_variable_t* var = map_get_key(copies);
+        jitc_variable_t* copy = map_get_value(copies);
+        bool defined = var->decltype == Decltype_None || var->decltype == Decltype_Static;
+        if (!defined || !var->func || var->type->kind != Type_Function) continue;
+        copy->func = jitc_relocate_function(context, var->func, copies);
+        map_add(storage) = var->func;
+        map_commit(storage);
+        map_get_value(storage) = copy->func;
+    }
+    for (size_t i = 0; i < map_size(copies); i++) {
+        map_index(copies, i);
+        jitc_variable_t* copy = map_get_value(copies);
+        if (copy->next_method && map_find(copies, &copy->next_method)) copy->next_method = map_get_value(copies);
+        if (copy->decltype == Decltype_Extern && copy->ptr && map_find(storage, &copy->ptr)) copy->ptr = map_get_value(storage);
+    }
+    // the source's own snapshot is folded in behind its global scope, so nothing it exposes stays shared
+    for (size_t i = 0; i < num_scopes; i++) {
+        for (size_t j = 0; j < map_size(scopes[i]->methods); j++) {
+            map_index(scopes[i]->methods, j);
+            jitc_variable_t* head = map_get_value(scopes[i]->methods);
+            map_find(copies, &head);
+            head = map_get_value(copies);
+            map_add(context->snapshot->methods) = map_get_key(scopes[i]->methods);
+            if (map_commit(context->snapshot->methods)) map_get_value(context->snapshot->methods) = head;
+            else {
+                jitc_variable_t* tail = map_get_value(context->snapshot->methods);
+                while (tail->next_method) tail = tail->next_method;
+                tail->next_method = head;
+            }
+        }
+        if (i == 0) continue;
+        map_t* tags[][2] = {
+            { scopes[i]->structs, context->snapshot->structs },
+            { scopes[i]->unions, context->snapshot->unions },
+            { scopes[i]->enums, context->snapshot->enums },
+        };
+        for (size_t j = 0; j < sizeof(tags) / sizeof(*tags); j++) {
+            map(char*, jitc_type_t*)* from = (void*)tags[j][0];
+            map(char*, jitc_type_t*)* to = (void*)tags[j][1];
+            for (size_t k = 0; k < map_size(from); k++) {
+                map_index(from, k);
+                map_add(to) = map_get_key(from);
+                if (map_commit(to)) map_get_value(to) = map_get_value(from);
+            }
+        }
+    }
+    for (size_t i = 0; i < list_size(source->imports); i++)
+        if (list_get(source->imports, i) != source->snapshot) list_add(context->imports) = list_get(source->imports, i);
+    list_add(context->imports) = context->snapshot;
+    context->prelude = source->prelude;
+    context->parent = source;
+    context->unresolved_symbol = source->unresolved_symbol;
+    context->cache_dir = source->cache_dir ? strdup(source->cache_dir) : NULL;
+    for (size_t i = 0; i < list_size(source->vfs->include_dirs); i++)
+        jitc_add_include_dir(context, list_get(source->vfs->include_dirs, i));
+    jitc_set_file_callback(context, source->vfs->callback, source->vfs->userdata);
+    source->refcount++;
     return context;
 }
 
 static jitc_variable_t* jitc_get_symbol(jitc_context_t* context, const char* name, bool normal_only) {
     jitc_scope_t* scope = &list_get(context->scopes, 0);
-    if (!map_find(scope->variables, &name)) return NULL;
-    jitc_variable_t* var = map_get_value(scope->variables);
+    jitc_variable_t* var = map_find(scope->variables, &name) ? map_get_value(scope->variables) : jitc_get_imported_variable(context, name);
+    if (!var) return NULL;
     if (var->decltype == Decltype_Typedef) return NULL;
     if (var->decltype == Decltype_Extern && normal_only) return NULL;
     if (var->decltype == Decltype_Static && normal_only) return NULL;
@@ -794,37 +1269,59 @@ const char* jitc_scoped_name(jitc_context_t* context, const char* name, uint32_t
     return jitc_append_string(context, new_name);
 }
 
-jitc_variable_t* jitc_get_method(jitc_context_t* context, jitc_type_t* base, const char* name, list_t* _templ_list, map_t** template_map) {
+static bool jitc_match_method(jitc_context_t* context, jitc_variable_t* var, jitc_type_t* base, list_t* _templ_list, map_t** template_map) {
     list(jitc_type_t*)* templ_list = _templ_list;
-    base = jitc_typecache_named(context, base, NULL);
-    jitc_scope_t* scope = &list_get(context->scopes, 0);
+    if ((var->type->kind == Type_Template) != !!templ_list) return false;
+    if (var->type->kind != Type_Template) return jitc_typecmp(context, var->type->func.params[0]->ptr.base, base);
+    if (var->type->templ.num_names != list_size(templ_list)) return false;
+    smartptr(map(char*, jitc_type_t*)) templ_map = arena_map_new(context->parse_arena, compare_string, char*, jitc_type_t*);
+    for (size_t j = 0; j < list_size(templ_list); j++) {
+        map_add(templ_map) = (char*)var->type->templ.names[j];
+        map_commit(templ_map);
+        map_get_value(templ_map) = list_get(templ_list, j);
+    }
+    jitc_type_t* filled = jitc_instantiate_template(context, var->type, templ_map);
+    if (!jitc_typecmp(context, filled->func.params[0]->ptr.base, base)) return false;
+    *template_map = move(templ_map);
+    return true;
+}
+
+static jitc_variable_t* jitc_find_method(jitc_context_t* context, jitc_scope_t* scope, jitc_type_t* base, const char* name, list_t* templ_list, map_t** template_map) {
+    if (!scope->methods) return NULL;
+    jitc_method_key_t key = { name, templ_list ? 0 : jitc_method_receiver(context, base) };
+    if (!map_find(scope->methods, &key)) return NULL;
+    jitc_variable_t* var = map_get_value(scope->methods);
+    if (!templ_list) return var;
+    for (; var; var = var->next_method)
+        if (jitc_match_method(context, var, base, templ_list, template_map)) return var;
+    return NULL;
+}
+
+// receivers declared through a tag that was only defined later are indexed under the unresolved tag
+static jitc_variable_t* jitc_scan_methods(jitc_context_t* context, jitc_scope_t* scope, jitc_type_t* base, const char* name, list_t* templ_list, map_t** template_map) {
     for (size_t i = 0; i < map_size(scope->variables); i++) {
         map_index(scope->variables, i);
         jitc_variable_t* var = map_get_value(scope->variables);
         const char* symbol_name = map_get_key(scope->variables);
-        const char* method_name = symbol_name + 18;
         if (strncmp(symbol_name, "@m", 2) != 0) continue;
-        if (strcmp(method_name, name) != 0) continue;
-        if ((var->type->kind == Type_Template) != !!templ_list) continue;
-        if (var->type->kind == Type_Template) {
-            if (var->type->templ.num_names != list_size(templ_list)) continue;
-            smartptr(map(char*, jitc_type_t*)) templ_map = map_new(compare_string, char*, jitc_type_t*);
-            for (size_t j = 0; j < list_size(templ_list); j++) {
-                map_add(templ_map) = (char*)var->type->templ.names[j];
-                map_commit(templ_map);
-                map_get_value(templ_map) = list_get(templ_list, j);
-            }
-            jitc_type_t* filled = jitc_typecache_fill_template(context, var->type, templ_map);
-            if (jitc_typecmp(context, filled->func.params[0]->ptr.base, base)) {
-                *template_map = move(templ_map);
-                return var;
-            }
-        }
-        else if (jitc_typecmp(context, var->type->func.params[0]->ptr.base, base)) return var;
+        if (strcmp(symbol_name + 18, name) != 0) continue;
+        if (jitc_match_method(context, var, base, templ_list, template_map)) return var;
     }
     return NULL;
 }
 
+jitc_variable_t* jitc_get_method(jitc_context_t* context, jitc_type_t* base, const char* name, list_t* templ_list, map_t** template_map) {
+    base = base->unnamed;
+    name = jitc_append_string(context, name);
+    jitc_variable_t* method = jitc_find_method(context, &list_get(context->scopes, 0), base, name, templ_list, template_map);
+    for (size_t i = list_size(context->imports) - 1; !method && i < list_size(context->imports); i--)
+        method = jitc_find_method(context, list_get(context->imports, i), base, name, templ_list, template_map);
+    if (!method) method = jitc_scan_methods(context, &list_get(context->scopes, 0), base, name, templ_list, template_map);
+    for (size_t i = list_size(context->imports) - 1; !method && i < list_size(context->imports); i--)
+        method = jitc_scan_methods(context, list_get(context->imports, i), base, name, templ_list, template_map);
+    return method;
+}
+
 jitc_type_t* jitc_mangle_template(jitc_context_t* context, jitc_type_t* base, map_t* _templ_map) {
     map(char*, jitc_type_t*)* templ_map = _templ_map;
     uint64_t hash = base->hash;
@@ -837,6 +1334,26 @@ jitc_type_t* jitc_mangle_template(jitc_context_t* context, jitc_type_t* base, ma
     return jitc_typecache_named(context, base, jitc_append_string(context, symbol_name));
 }
 
+jitc_type_t* jitc_instantiate_template(jitc_context_t* context, jitc_type_t* templ, map_t* _templ_map) {
+    map(char*, jitc_type_t*)* templ_map = _templ_map;
+    jitc_type_t* args[map_size(templ_map) + 1];
+    for (size_t i = 0; i < map_size(templ_map); i++) {
+        map_index(templ_map, i);
+        args[i] = map_get_value(templ_map);
+    }
+    jitc_instance_key_t key = { templ, args, map_size(templ_map) };
+    for (jitc_context_t* ctx = context; ctx; ctx = ctx->parent)
+        if (map_find(ctx->instances, &key)) return map_get_value(ctx->instances);
+    jitc_type_t* filled = jitc_typecache_fill_template(context, templ, templ_map);
+    if (!filled) return NULL;
+    jitc_type_t* type = jitc_mangle_template(context, filled, templ_map);
+    key.args = arena_memdup(context->arena, args, sizeof(jitc_type_t*) * key.num_args);
+    map_add(context->instances) = key;
+    map_commit(context->instances);
+    map_get_value(context->instances) = type;
+    return type;
+}
+
 bool jitc_walk_struct(jitc_type_t* str, const char* name, jitc_type_t** field_type, size_t* offset) {
     for (size_t i = 0; i < str->str.num_fields; i++) {
         jitc_type_t* field = str->str.fields[i];
@@ -873,50 +1390,230 @@ bool jitc_struct_field_exists_list(list_t* _list, const char* name) {
     return false;
 }
 
-static char* read_whole_file(jitc_context_t* context, const char* filename) {
-    FILE* f = fopen(filename, "r");
+bool jitc_load_file(jitc_context_t* context, const char* filename, jitc_source_file_t* file) {
+    *file = (jitc_source_file_t){};
+#ifndef _WIN32
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        replace(context->error) = jitc_error_syntax(filename, 0, 0, "Failed to open: %s", strerror(errno));
+        return false;
+    }
+    defer { close(fd); }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            file->data = data;
+            file->size = st.st_size;
+            file->mapped = true;
+            return true;
+        }
+    }
+    size_t capacity = 4096;
+    file->data = malloc(capacity);
+    while (true) {
+        ssize_t bytes = read(fd, file->data + file->size, capacity - file->size);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes < 0) {
+            free(file->data);
+            replace(context->error) = jitc_error_syntax(filename, 0, 0, "Failed to read: %s", strerror(errno));
+            return false;
+        }
+        if (bytes == 0) break;
+        file->size += bytes;
+        if (file->size == capacity) file->data = realloc(file->data, capacity *= 2);
+    }
+#else
+    FILE* f = fopen(filename, "rb");
     if (!f) {
         replace(context->error) = jitc_error_syntax(filename, 0, 0, "Failed to open: %s", strerror(errno));
-        return NULL;
+        return false;
     }
     fseek(f, 0, SEEK_END);
-    size_t size = ftell(f);
+    file->size = ftell(f);
     fseek(f, 0, SEEK_SET);
-    char* code = malloc(size + 1);
-    fread(code, size, 1, f);
-    code[size] = 0;
+    file->data = malloc(file->size + 1);
+    file->size = fread(file->data, 1, file->size, f);
     fclose(f);
-    return code;
+#endif
+    return true;
+}
+
+void jitc_unload_file(jitc_source_file_t* file) {
+#ifndef _WIN32
+    if (file->mapped) {
+        munmap(file->data, file->size);
+        return;
+    }
+#endif
+    free(file->data);
+}
+
+static jitc_prelude_header_t* jitc_prelude_header(jitc_context_t* context, const char* name, uint64_t hash) {
+    jitc_prelude_t* prelude = jitc_get_prelude(context);
+    if (!prelude || !map_find(prelude->headers, &name)) return NULL;
+    jitc_prelude_header_t* header = &map_get_value(prelude->headers);
+    return header->hash == hash ? header : NULL;
+}
+
+bool jitc_attach_import(jitc_context_t* context, const char* name, uint64_t hash) {
+    jitc_prelude_header_t* header = jitc_prelude_header(context, name, hash);
+    if (!header) return false;
+    for (size_t i = 0; i < list_size(context->imports); i++) {
+        if (list_get(context->imports, i) == &header->scope) return true;
+    }
+    list_add(context->imports) = &header->scope;
+    return true;
 }
 
-queue_t* jitc_include(jitc_context_t* context, jitc_token_t* token, const char* filename, map_t* macros, list_t* dependencies) {
-    smartptr(queue(jitc_token_t)) tokens = NULL;
-    if (!map_find(context->headers, &filename)) {
-        autofree char* content = try(read_whole_file(context, filename));
-        tokens = try(jitc_lex(context, content, filename));
+static bool jitc_import_prelude(jitc_context_t* context, jitc_header_key_t key, map_t* macros) {
+    jitc_prelude_header_t* header = jitc_prelude_header(context, key.name, key.hash);
+    if (!header) return false;
+    if (map_find(macros, &header->guard)) return true;
+    if (!jitc_import_macros(macros, header->macros, header->words)) return false;
+    return jitc_attach_import(context, key.name, key.hash);
+}
+
+bool jitc_header_hash(jitc_context_t* context, const char* name, uint64_t* hash) {
+    jitc_header_t* header = jitc_find_header(context, name);
+    if (header) {
+        *hash = header->hash;
+        return true;
     }
-    else tokens = try(jitc_lex(context, map_get_value(context->headers), filename));
-    tokens = try(jitc_preprocess(context, move(tokens), macros, dependencies));
-    return move(tokens);
+    jitc_vfs_file_t* file = jitc_vfs_lookup(context, name);
+    if (!file) return false;
+    *hash = file->hash;
+    return true;
+}
+
+static void jitc_record_include(jitc_context_t* context, jitc_header_key_t key, bool prelude) {
+    if (!context->recording) return;
+    list_add(context->recording->deps) = (jitc_cache_dep_t){ key.name, key.hash, prelude };
+}
+
+list_t* jitc_include(jitc_context_t* context, jitc_token_t* token, const char* filename, map_t* macros, list_t* dependencies) {
+    jitc_header_key_t key = { jitc_append_string(context, filename) };
+    const char* content;
+    size_t length;
+    jitc_header_t* registered = jitc_find_header(context, key.name);
+    if (registered) {
+        content = registered->content;
+        length = registered->length;
+        key.hash = registered->hash;
+        if (jitc_import_prelude(context, key, macros)) {
+            jitc_record_include(context, key, true);
+            list(jitc_token_t)* tokens = list_new(jitc_token_t);
+            list_add(tokens) = (jitc_token_t){ .type = TOKEN_END_OF_FILE, .filename = key.name };
+            return tokens;
+        }
+    }
+    else {
+        jitc_vfs_file_t* file = jitc_vfs_find(context, token->filename, filename);
+        if (!file) return jitc_error_set(context, jitc_error_parser(context, token, "File '%s' not found", filename)), NULL;
+        key = (jitc_header_key_t){ file->path, file->hash };
+        content = file->source.data;
+        length = file->source.size;
+    }
+    // a file keeps one entry, edited contents replace the stale tokens
+    if (!map_find(context->header_cache, &key.name) || map_get_value(context->header_cache).hash != key.hash) {
+        list(jitc_token_t)* tokens = try(jitc_lex(context, content, length, key.name));
+        map_add(context->header_cache) = key.name;
+        if (!map_commit(context->header_cache)) list_delete(map_get_value(context->header_cache).tokens);
+        map_get_value(context->header_cache) = (jitc_cached_header_t){ (void*)tokens, jitc_include_guard(context, tokens), key.hash };
+    }
+    jitc_record_include(context, key, false);
+    jitc_cached_header_t header = map_get_value(context->header_cache);
+    if (header.guard && map_find(macros, &header.guard)) {
+        list(jitc_token_t)* tokens = list_new(jitc_token_t);
+        list_add(tokens) = list_get((list(jitc_token_t)*)header.tokens, list_size(header.tokens) - 1);
+        return tokens;
+    }
+    return jitc_preprocess(context, header.tokens, macros, dependencies);
+}
+
+jitc_embed_t* jitc_embed_bytes(jitc_context_t* context, const char* data, size_t size) {
+    jitc_embed_t* embed = arena_alloc(context->embed_arena, sizeof(jitc_embed_t) + size);
+    embed->size = size;
+    memcpy(embed->data, data, size);
+    return embed;
+}
+
+jitc_embed_t* jitc_embed(jitc_context_t* context, jitc_token_t* token, const char* filename, uint64_t limit) {
+    jitc_header_key_t key = { jitc_append_string(context, filename) };
+    const char* content;
+    size_t length;
+    jitc_header_t* registered = jitc_find_header(context, key.name);
+    if (registered) {
+        content = registered->content;
+        length = registered->length;
+        key.hash = registered->hash;
+    }
+    else {
+        jitc_vfs_file_t* file = jitc_vfs_find(context, token->filename, filename);
+        if (!file) return jitc_error_set(context, jitc_error_parser(context, token, "File '%s' not found", filename)), NULL;
+        key = (jitc_header_key_t){ file->path, file->hash };
+        content = file->source.data;
+        length = file->source.size;
+    }
+    jitc_record_include(context, key, false);
+    return jitc_embed_bytes(context, content, length < limit ? length : limit);
 }
 
 void jitc_create_header(jitc_context_t* context, const char* name, const char* content) {
-    map_add(context->headers) = (char*)name;
-    map_commit(context->headers);
-    map_get_value(context->headers) = jitc_append_string(context, content);
+    map_add(context->headers) = jitc_append_string(context, name);
+    if (!map_commit(context->headers)) free(map_get_value(context->headers).content);
+    size_t length = strlen(content);
+    map_get_value(context->headers) = (jitc_header_t){
+        .content = memcpy(malloc(length + 1), content, length + 1),
+        .length = length,
+        .hash = hash_bytes(content, length),
+    };
 }
 
 bool jitc_parse(jitc_context_t* context, const char* code, const char* filename) {
-    smartptr(queue(jitc_token_t)) tokens = try(jitc_lex(context, code, filename));
+    return jitc_parse_n(context, code, strlen(code), filename);
+}
+
+bool jitc_parse_n(jitc_context_t* context, const char* code, size_t length, const char* filename) {
+    return jitc_parse_macros(context, code, length, filename, NULL);
+}
+
+static list_t* jitc_tokenize(jitc_context_t* context, const char* code, size_t length, const char* filename, map_t* macros, list_t* dependencies) {
+    jitc_vfs_reset(context->vfs);
+    bool cached = context->cache_dir && !macros;
+    uint64_t key = 0;
+    if (cached) {
+        key = jitc_cache_key(code, length, filename);
+        list_t* tokens = jitc_cache_load(context, key, filename, dependencies);
+        if (tokens) return tokens;
+    }
+    smartptr(list(jitc_token_t)) lexed = try(jitc_lex(context, code, length, filename));
 #if JITC_DEBUG || JITC_DEBUG_TOKENS
-    extern queue_t* print_tokens(const char* source, queue_t* tokens);
-    tokens = print_tokens("Lexer", tokens);
+    extern void print_tokens(const char* source, list_t* tokens);
+    print_tokens("Lexer", lexed);
 #endif
-    tokens = try(jitc_preprocess(context, move(tokens), NULL, NULL));
+    if (!cached) return jitc_preprocess(context, lexed, macros, dependencies);
+    jitc_cache_recording_t recording = { .deps = list_new(jitc_cache_dep_t) };
+    context->recording = &recording;
+    list_t* tokens = jitc_preprocess(context, lexed, macros, dependencies);
+    context->recording = NULL;
+    if (tokens && !recording.uncacheable) jitc_cache_store(context, key, filename, tokens, dependencies, recording.deps);
+    list_delete(recording.deps);
+    return tokens;
+}
+
+bool jitc_parse_tokens(jitc_context_t* context, list_t* tokens) {
 #if JITC_DEBUG || JITC_DEBUG_PREPROCESSOR
-    tokens = print_tokens("Preprocessor", tokens);
+    extern void print_tokens(const char* source, list_t* tokens);
+    print_tokens("Preprocessor", tokens);
 #endif
-    smartptr(jitc_ast_t) ast = jitc_parse_ast(context, tokens);
+    defer {
+        arena_clear(context->parse_arena);
+        // queued build tasks still point at their embedded bytes
+        if (map_size(context->tasks) == 0) arena_clear(context->embed_arena);
+    }
+    jitc_token_stream_t stream = jitc_token_stream(tokens);
+    jitc_ast_t* ast = jitc_parse_ast(context, &stream);
 #if JITC_DEBUG || JITC_DEBUG_AST
     extern void print_ast(jitc_ast_t* ast, int indent);
     print_ast(ast, 0);
@@ -931,9 +1628,16 @@ bool jitc_parse(jitc_context_t* context, const char* code, const char* filename)
     return true;
 }
 
+static bool jitc_parse_macros(jitc_context_t* context, const char* code, size_t length, const char* filename, map_t* macros) {
+    smartptr(list(jitc_token_t)) tokens = try(jitc_tokenize(context, code, length, filename, macros, NULL));
+    return jitc_parse_tokens(context, tokens);
+}
+
 bool jitc_parse_file(jitc_context_t* context, const char* filename) {
-    autofree char* code = try(read_whole_file(context, filename));
-    return try(jitc_parse(context, code, filename));
+    jitc_source_file_t file;
+    try(jitc_load_file(context, filename, &file));
+    defer { jitc_unload_file(&file); }
+    return try(jitc_parse_n(context, file.data, file.size, filename));
 }
 
 void* jitc_get(jitc_context_t* context, const char* name) {
@@ -944,22 +1648,30 @@ void* jitc_get(jitc_context_t* context, const char* name) {
 }
 
 void jitc_destroy_context(jitc_context_t* context) {
-    for (size_t i = 0; i < set_size(context->strings); i++) {
-        free(set_get(context->strings, i));
-    }
-    set_delete(context->strings);
-    for (size_t i = 0; i < map_size(context->typecache); i++) {
-        map_index(context->typecache, i);
-        jitc_type_t* type = map_get_value(context->typecache);
-        if (type->kind == Type_Function) free(type->func.params);
-        if (type->kind == Type_Struct || type->kind == Type_Union) {
-            free(type->str.fields);
-            free(type->str.offsets);
-        }
-        free(type);
-    }
+    if (--context->refcount > 0) return;
+    if (context->prelude && context->prelude->context == context) jitc_destroy_prelude(context->prelude);
+    interner_delete(context->strings);
+    list_delete(context->expansions);
+    map_delete(context->expansion_index);
     map_delete(context->typecache);
+    map_delete(context->instances);
+    for (size_t i = 0; i < map_size(context->headers); i++) {
+        map_index(context->headers, i);
+        free(map_get_value(context->headers).content);
+    }
     map_delete(context->headers);
+    for (size_t i = 0; i < map_size(context->header_cache); i++) {
+        map_index(context->header_cache, i);
+        list_delete(map_get_value(context->header_cache).tokens);
+    }
+    map_delete(context->header_cache);
+    list_delete(context->imports);
+    free(context->cache_dir);
+    jitc_vfs_delete(context->vfs);
+    if (context->snapshot) {
+        jitc_destroy_scope(context->snapshot);
+        free(context->snapshot);
+    }
     map_delete(context->tasks);
     list_delete(context->labels);
     queue_delete(context->instantiation_requests);
@@ -967,19 +1679,32 @@ void jitc_destroy_context(jitc_context_t* context) {
     while (list_size(context->scopes) > 1) jitc_pop_scope(context);
     jitc_destroy_scope(&list_get(context->scopes, 0));
     list_delete(context->scopes);
+    map_delete(context->local_variables);
+    map_delete(context->local_structs);
+    map_delete(context->local_unions);
+    map_delete(context->local_enums);
+    list_delete(context->undo_log);
+    arena_delete(context->parse_arena);
+    arena_delete(context->embed_arena);
+    arena_delete(context->arena);
+    jitc_context_t* parent = context->parent;
     free(context);
+    if (parent) jitc_destroy_context(parent);
 }
 
 #define throw_impl(filename, ...) jitc_error_set(context, jitc_error_syntax(filename, 0, 0, __VA_ARGS__))
 
 bool jitc_append_task(jitc_context_t* context, const char* code, const char* filename) {
+    return jitc_append_task_n(context, code, strlen(code), filename);
+}
+
+bool jitc_append_task_n(jitc_context_t* context, const char* code, size_t length, const char* filename) {
     if (!filename) throw("<memory>", "Filename can't be null");
     if (map_find(context->tasks, &filename)) throw(filename, "Duplicate compile task");
     jitc_build_task_t task;
-    smartptr(queue(jitc_token_t)) tokens = try(jitc_lex(context, code, filename));
     smartptr(list(jitc_token_t)) dependencies = list_new(jitc_token_t);
     task.state = TaskState_Unvisited;
-    task.tokens = try(jitc_preprocess(context, move(tokens), NULL, dependencies));
+    task.tokens = try(jitc_tokenize(context, code, length, filename, NULL, dependencies));
     task.dependencies = (void*)move(dependencies);
     map_add(context->tasks) = (char*)filename;
     map_commit(context->tasks);
@@ -988,8 +1713,10 @@ bool jitc_append_task(jitc_context_t* context, const char* code, const char* fil
 }
 
 bool jitc_append_task_file(jitc_context_t* context, const char* filename) {
-    autofree char* code = try(read_whole_file(context, filename));
-    return try(jitc_append_task(context, code, filename));
+    jitc_source_file_t file;
+    try(jitc_load_file(context, filename, &file));
+    defer { jitc_unload_file(&file); }
+    return try(jitc_append_task_n(context, file.data, file.size, filename));
 }
 
 static bool jitc_dfs_cycle(jitc_context_t* context, jitc_build_task_t* task, stack_t* _stack) {
@@ -1002,16 +1729,16 @@ static bool jitc_dfs_cycle(jitc_context_t* context, jitc_build_task_t* task, sta
     }
     smartptr(string_t) string = str_new();
     while (stack_size(stack) > 0) {
-        jitc_token_t* tok = &queue_peek(stack_pop(stack)->tokens);
-        str_appendf(string, "'%s' -> ", tok->locations[tok->num_locations - 1].filename);
+        jitc_token_t* tok = &list_get(stack_pop(stack)->tokens, 0);
+        str_appendf(string, "'%s' -> ", jitc_token_root_file(context, tok));
     }
-    jitc_token_t* tok = &queue_peek(task->tokens);
-    str_appendf(string, "'%s'", tok->locations[tok->num_locations - 1].filename);
+    jitc_token_t* tok = &list_get(task->tokens, 0);
+    str_appendf(string, "'%s'", jitc_token_root_file(context, tok));
     throw(NULL, "Dependency cycle detected (%s)", str_data(string));
 }
 
 #undef throw_impl
-#define throw_impl(...) jitc_error_set(context, jitc_error_parser(token, __VA_ARGS__))
+#define throw_impl(...) jitc_error_set(context, jitc_error_parser(context, token, __VA_ARGS__))
 
 static bool jitc_dfs(jitc_context_t* context, jitc_build_task_t* task, list_t* _out, stack_t* _stack) {
     list(jitc_build_task_t*)* out = _out;
@@ -1043,17 +1770,22 @@ static list_t* jitc_sort_builds(jitc_context_t* context) {
 }
 
 bool jitc_build(jitc_context_t* context, jitc_build_callback_t callback) {
-    defer { map_clear(context->tasks); }
+    defer {
+        map_clear(context->tasks);
+        arena_clear(context->embed_arena);
+    }
     smartptr(list(jitc_build_task_t*)) tasks = try(jitc_sort_builds(context));
     for (size_t i = 0; i < list_size(tasks); i++) {
         if (callback) {
-            jitc_token_t* tok = &queue_peek(list_get(tasks, i)->tokens);
+            jitc_token_t* tok = &list_get(list_get(tasks, i)->tokens, 0);
             callback(
-                tok->locations[tok->num_locations - 1].filename,
+                jitc_token_root_file(context, tok),
                 list_size(tasks), i
             );
         }
-        smartptr(jitc_ast_t) ast = jitc_parse_ast(context, list_get(tasks, i)->tokens);
+        defer { arena_clear(context->parse_arena); }
+        jitc_token_stream_t stream = jitc_token_stream(list_get(tasks, i)->tokens);
+        jitc_ast_t* ast = jitc_parse_ast(context, &stream);
         while (jitc_pop_scope(context));
         while (queue_size(context->instantiation_requests) > 0) queue_pop(context->instantiation_requests);
         if (!ast) return false;
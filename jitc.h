@@ -14,9 +14,11 @@ typedef struct {
 } jitc_source_location_t;
 
 typedef void(*jitc_build_callback_t)(const char* curr_file, int num_files_total, int num_files_compiled);
+typedef const char*(*jitc_file_callback_t)(void* userdata, const char* path, size_t* length);
 
 typedef struct jitc_context_t jitc_context_t;
 typedef struct jitc_error_t jitc_error_t;
+typedef struct jitc_stream_t jitc_stream_t;
 struct jitc_error_t {
     const char* msg;
     int num_locations;
@@ -30,9 +32,17 @@ struct jitc_error_t {
 };
 
 jitc_context_t* jitc_create_context();
+jitc_context_t* jitc_clone_context(jitc_context_t* context);
 void jitc_create_header(jitc_context_t* context, const char* name, const char* content);
+void jitc_set_cache_dir(jitc_context_t* context, const char* path);
+void jitc_add_include_dir(jitc_context_t* context, const char* path);
+void jitc_set_file_callback(jitc_context_t* context, jitc_file_callback_t callback, void* userdata);
 bool jitc_parse(jitc_context_t* context, const char* code, const char* filename);
+bool jitc_parse_n(jitc_context_t* context, const char* code, size_t length, const char* filename);
 bool jitc_parse_file(jitc_context_t* context, const char* filename);
+jitc_stream_t* jitc_stream_begin(jitc_context_t* context, const char* filename);
+bool jitc_stream_feed(jitc_stream_t* stream, const char* data, size_t length);
+bool jitc_stream_end(jitc_stream_t* stream);
 void* jitc_get(jitc_context_t* context, const char* name);
 void jitc_destroy_context(jitc_context_t* context);
 
@@ -42,6 +52,7 @@ void jitc_destroy_error(jitc_error_t* error);
 void jitc_report_error(jitc_context_t* context, FILE* stream);
 
 bool jitc_append_task(jitc_context_t* context, const char* code, const char* filename);
+bool jitc_append_task_n(jitc_context_t* context, const char* code, size_t length, const char* filename);
 bool jitc_append_task_file(jitc_context_t* context, const char* filename);
 bool jitc_build(jitc_context_t* context, jitc_build_callback_t callback);
 
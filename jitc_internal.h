@@ -5,6 +5,8 @@
 #include "dynamics.h"
 #include "cleanups.h"
 
+#include <stdatomic.h>
+
 typedef struct jitc_token_t jitc_token_t;
 
 #define jitc_decltype_t(ITEM) \
@@ -62,6 +64,7 @@ typedef struct jitc_token_t jitc_token_t;
     ITEM(AST_Variable) \
     ITEM(AST_WalkStruct) \
     ITEM(AST_Initializer) \
+    ITEM(AST_Blob) \
     ITEM(AST_Goto) \
     ITEM(AST_Label) \
     ITEM(AST_Interrupt) \
@@ -245,6 +248,7 @@ struct jitc_type_t {
     const char* name;
     uint32_t alignment, size;
     uint64_t hash;
+    jitc_type_t* unnamed;
     union {
         struct {
             jitc_type_t* base;
@@ -283,10 +287,19 @@ struct jitc_type_t {
     };
 };
 
+typedef struct jitc_variable_t jitc_variable_t;
+
+typedef struct {
+    size_t offset;
+    jitc_variable_t* var;
+} jitc_reloc_t;
+
 typedef struct {
     void* curr_ptr;
     void* ptr;
     size_t size;
+    jitc_reloc_t* relocs;
+    size_t num_relocs;
 } jitc_func_cell_t;
 
 typedef struct __attribute__((packed)) {
@@ -295,7 +308,7 @@ typedef struct __attribute__((packed)) {
     char jmp_rax[2];
 } jitc_func_trampoline_t;
 
-typedef struct {
+struct jitc_variable_t {
     jitc_type_t* type;
     const char* extern_symbol;
     jitc_decltype_t decltype;
@@ -307,7 +320,8 @@ typedef struct {
         uint64_t enum_value;
         jitc_func_trampoline_t* func;
     };
-} jitc_variable_t;
+    jitc_variable_t* next_method;
+};
 
 typedef struct {
     jitc_decltype_t decltype;
@@ -393,6 +407,10 @@ struct jitc_ast_t {
             list(size_t)* offsets;
             list(jitc_ast_t*)* items;
         } init;
+        struct {
+            jitc_variable_t* data;
+            size_t size;
+        } blob;
     };
 };
 
@@ -413,28 +431,141 @@ typedef struct {
     size_t avail;
 } jitc_memchunk_t;
 
+typedef struct {
+    const char* name;
+    uint64_t receiver;
+} jitc_method_key_t;
+
+typedef struct {
+    jitc_type_t* templ;
+    jitc_type_t** args;
+    size_t num_args;
+} jitc_instance_key_t;
+
 typedef struct {
     map(char*, jitc_variable_t*)* variables;
+    map(jitc_method_key_t, jitc_variable_t*)* methods;
     map(char*, jitc_type_t*)* structs;
     map(char*, jitc_type_t*)* unions;
     map(char*, jitc_type_t*)* enums;
-    bool func;
+    size_t func_depth;
+    size_t undo_mark;
     uint32_t scope_id;
 } jitc_scope_t;
 
+typedef struct jitc_binding_t jitc_binding_t;
+struct jitc_binding_t {
+    void* value;
+    size_t depth;
+    jitc_binding_t* shadowed;
+};
+
+typedef struct {
+    map_t* table;
+    const char* name;
+} jitc_undo_t;
+
 typedef struct {
     jitc_task_state_t state;
-    queue(jitc_token_t)* tokens;
+    list(jitc_token_t)* tokens;
     list(jitc_token_t)* dependencies;
 } jitc_build_task_t;
 
+typedef struct {
+    jitc_source_location_t location;
+    uint32_t parent;
+} jitc_expansion_t;
+
+typedef struct {
+    char* content;
+    size_t length;
+    uint64_t hash;
+} jitc_header_t;
+
+typedef struct {
+    const char* name;
+    uint64_t hash;
+} jitc_header_key_t;
+
+typedef struct {
+    list(jitc_token_t)* tokens;
+    const char* guard;
+    uint64_t hash;
+} jitc_cached_header_t;
+
+typedef struct {
+    map_t* macros;
+    set(char*)* words;
+    jitc_scope_t scope;
+    const char* guard;
+    uint64_t hash;
+} jitc_prelude_header_t;
+
+typedef struct {
+    jitc_context_t* context;
+    map(char*, jitc_prelude_header_t)* headers;
+} jitc_prelude_t;
+
+typedef struct {
+    const char* name;
+    uint64_t hash;
+    bool prelude;
+    bool missing;
+} jitc_cache_dep_t;
+
+typedef struct {
+    list(jitc_cache_dep_t)* deps;
+    bool uncacheable;
+} jitc_cache_recording_t;
+
+typedef struct {
+    char* data;
+    size_t size;
+    bool mapped;
+} jitc_source_file_t;
+
+typedef struct {
+    const char* path;
+    jitc_source_file_t source;
+    uint64_t hash;
+} jitc_vfs_file_t;
+
+typedef struct {
+    list(char*)* include_dirs;
+    jitc_file_callback_t callback;
+    void* userdata;
+    map(char*, jitc_vfs_file_t*)* files;
+    map(char*, char*)* resolved;
+} jitc_vfs_t;
+
 struct jitc_context_t {
-    set(char*)* strings;
+    arena_t* arena;
+    arena_t* parse_arena;
+    arena_t* embed_arena;
+    interner_t* strings;
+    list(jitc_expansion_t)* expansions;
+    map(jitc_expansion_t, uint32_t)* expansion_index;
     map(uint64_t, jitc_type_t*)* typecache;
-    map(char*, char*)* headers;
+    map(jitc_instance_key_t, jitc_type_t*)* instances;
+    map(char*, jitc_header_t)* headers;
+    map(const char*, jitc_cached_header_t)* header_cache;
+    jitc_prelude_t* prelude;
+    bool prelude_pending;
+    jitc_context_t* parent;
+    jitc_scope_t* snapshot;
+    list(jitc_scope_t*)* imports;
+    atomic_int refcount;
+    char* cache_dir;
+    jitc_cache_recording_t* recording;
+    jitc_vfs_t* vfs;
     map(char*, jitc_build_task_t)* tasks;
     list(char*)* labels;
     list(jitc_scope_t)* scopes;
+    map(char*, jitc_binding_t*)* local_variables;
+    map(char*, jitc_binding_t*)* local_structs;
+    map(char*, jitc_binding_t*)* local_unions;
+    map(char*, jitc_binding_t*)* local_enums;
+    list(jitc_undo_t)* undo_log;
     list(jitc_memchunk_t)* memchunks;
     queue(jitc_instantiation_request_t)* instantiation_requests;
     jitc_error_t* error;
@@ -454,6 +585,7 @@ struct jitc_context_t {
     SPECIAL(END_OF_FILE) \
     SPECIAL(IDENTIFIER) \
     SPECIAL(STRING) \
+    SPECIAL(EMBED) \
     SPECIAL(INTEGER) \
     SPECIAL(FLOAT) \
     KEYWORD(alignof) \
@@ -573,28 +705,74 @@ typedef union {
     } float_flags;
 } jitc_token_flags_t;
 
+typedef struct {
+    size_t size;
+    char data[];
+} jitc_embed_t;
+
 struct jitc_token_t {
     bool disabled;
     jitc_token_type_t type;
     jitc_token_flags_t flags;
-    int num_locations;
-    union {
-        jitc_source_location_t locations[JITC_LOCATION_DEPTH];
-        struct {
-            int row, col;
-            const char* filename;
-        };
-    };
+    uint32_t expansion;
+    int row, col;
+    const char* filename;
     union {
         char* string;
+        jitc_embed_t* embed;
         uint64_t integer;
         double floating;
     } value;
 };
 
-jitc_token_t* jitc_token_expect(queue_t* token_queue, jitc_token_type_t kind);
-queue_t* jitc_lex(jitc_context_t* context, const char* code, const char* filename);
-queue_t* jitc_preprocess(jitc_context_t* context, queue_t* tokens, map_t* macros, list_t* dependencies);
+typedef struct {
+    jitc_token_t* tokens;
+    size_t ptr, end;
+} jitc_token_stream_t;
+
+static inline jitc_token_stream_t jitc_token_stream(list_t* tokens) {
+    return (jitc_token_stream_t){ __list_get(tokens, 0), 0, list_size(tokens) };
+}
+
+static inline jitc_token_stream_t jitc_token_substream(jitc_token_stream_t* stream, size_t start, size_t end) {
+    return (jitc_token_stream_t){ stream->tokens, start, end };
+}
+
+static inline jitc_token_t* jitc_stream_peek(jitc_token_stream_t* stream) {
+    return stream->ptr < stream->end ? &stream->tokens[stream->ptr] : NULL;
+}
+
+static inline jitc_token_t* jitc_stream_pop(jitc_token_stream_t* stream) {
+    return stream->ptr < stream->end ? &stream->tokens[stream->ptr++] : NULL;
+}
+
+static inline size_t jitc_stream_size(jitc_token_stream_t* stream) {
+    return stream->end - stream->ptr;
+}
+
+static inline size_t jitc_stream_mark(jitc_token_stream_t* stream) {
+    return stream->ptr;
+}
+
+static inline void jitc_stream_reset(jitc_token_stream_t* stream, size_t mark) {
+    stream->ptr = mark;
+}
+
+jitc_token_t* jitc_token_expect(jitc_token_stream_t* tokens, jitc_token_type_t kind);
+jitc_token_type_t jitc_keyword(const char* str, size_t length);
+list_t* jitc_lex(jitc_context_t* context, const char* code, size_t length, const char* filename);
+list_t* jitc_lex_from(jitc_context_t* context, const char* code, size_t length, const char* filename, int row);
+list_t* jitc_preprocess(jitc_context_t* context, list_t* tokens, map_t* macros, list_t* dependencies);
+const char* jitc_include_guard(jitc_context_t* context, list_t* tokens);
+map_t* jitc_macro_table();
+void jitc_delete_macro_table(map_t* macros);
+void jitc_collect_words(set_t* words, list_t* tokens);
+bool jitc_import_macros(map_t* macros, map_t* snapshot, set_t* words);
+uint64_t jitc_hash_predefined();
+
+uint64_t jitc_cache_key(const char* code, size_t length, const char* filename);
+list_t* jitc_cache_load(jitc_context_t* context, uint64_t key, const char* filename, list_t* dependencies);
+void jitc_cache_store(jitc_context_t* context, uint64_t key, const char* filename, list_t* tokens, list_t* dependencies, list_t* deps);
 
 jitc_type_t* jitc_typecache_primitive(jitc_context_t* context, jitc_type_kind_t kind);
 jitc_type_t* jitc_typecache_unsigned(jitc_context_t* context, jitc_type_t* base);
@@ -622,6 +800,7 @@ bool jitc_declare_tagged_type(jitc_context_t* context, jitc_type_t* type, const
 
 jitc_variable_t* jitc_get_variable(jitc_context_t* context, const char* name);
 jitc_type_t* jitc_mangle_template(jitc_context_t* context, jitc_type_t* type, map_t* templ_map);
+jitc_type_t* jitc_instantiate_template(jitc_context_t* context, jitc_type_t* templ, map_t* templ_map);
 jitc_type_t* jitc_get_tagged_type_notype(jitc_context_t* context, jitc_type_kind_t kind, const char* name);
 jitc_type_t* jitc_get_tagged_type(jitc_context_t* context, jitc_type_t* type);
 jitc_variable_t* jitc_get_or_static(jitc_context_t* context, const char* name);
@@ -637,24 +816,39 @@ void jitc_push_scope(jitc_context_t* context);
 bool jitc_pop_scope(jitc_context_t* context);
 
 jitc_error_t* jitc_error_syntax(const char* filename, int row, int col, const char* str, ...);
-jitc_error_t* jitc_error_parser(jitc_token_t* token, const char* str, ...);
+jitc_error_t* jitc_error_parser(jitc_context_t* context, jitc_token_t* token, const char* str, ...);
 void jitc_error_set(jitc_context_t* context, jitc_error_t* error);
-void jitc_push_location(jitc_token_t* token, const char* filename, int row, int col);
+uint32_t jitc_add_expansion(jitc_context_t* context, uint32_t parent, const char* filename, int row, int col);
+void jitc_push_location(jitc_context_t* context, jitc_token_t* token, const char* filename, int row, int col);
+const char* jitc_token_root_file(jitc_context_t* context, jitc_token_t* token);
 
 bool jitc_validate_type(jitc_type_t* type, jitc_type_policy_t policy);
 
 char* jitc_append_string(jitc_context_t* context, const char* string);
-queue_t* jitc_include(jitc_context_t* context, jitc_token_t* token, const char* filename, map_t* macros, list_t* dependencies);
-
-jitc_type_t* jitc_parse_type(jitc_context_t* context, queue_t* tokens, jitc_decltype_t* decltype, jitc_preserve_t* preserve_policy);
-jitc_ast_t* jitc_parse_expression(jitc_context_t* context, queue_t* tokens, int min_prec, jitc_type_t** exprtype);
-jitc_ast_t* jitc_parse_statement(jitc_context_t* context, queue_t* tokens, jitc_parse_type_t allowed);
-jitc_ast_t* jitc_parse_ast(jitc_context_t* context, queue_t* token_queue);
+char* jitc_append_string_n(jitc_context_t* context, const char* string, size_t length);
+list_t* jitc_include(jitc_context_t* context, jitc_token_t* token, const char* filename, map_t* macros, list_t* dependencies);
+jitc_embed_t* jitc_embed(jitc_context_t* context, jitc_token_t* token, const char* filename, uint64_t limit);
+jitc_embed_t* jitc_embed_bytes(jitc_context_t* context, const char* data, size_t size);
+bool jitc_load_file(jitc_context_t* context, const char* filename, jitc_source_file_t* file);
+void jitc_unload_file(jitc_source_file_t* file);
+jitc_vfs_t* jitc_vfs_new();
+void jitc_vfs_reset(jitc_vfs_t* vfs);
+void jitc_vfs_delete(jitc_vfs_t* vfs);
+jitc_vfs_file_t* jitc_vfs_lookup(jitc_context_t* context, const char* path);
+jitc_vfs_file_t* jitc_vfs_find(jitc_context_t* context, const char* includer, const char* name);
+bool jitc_header_hash(jitc_context_t* context, const char* name, uint64_t* hash);
+bool jitc_attach_import(jitc_context_t* context, const char* name, uint64_t hash);
+
+jitc_type_t* jitc_parse_type(jitc_context_t* context, jitc_token_stream_t* tokens, jitc_decltype_t* decltype, jitc_preserve_t* preserve_policy);
+jitc_ast_t* jitc_parse_expression(jitc_context_t* context, jitc_token_stream_t* tokens, int min_prec, jitc_type_t** exprtype);
+jitc_ast_t* jitc_parse_statement(jitc_context_t* context, jitc_token_stream_t* tokens, jitc_parse_type_t allowed);
+jitc_ast_t* jitc_parse_ast(jitc_context_t* context, jitc_token_stream_t* tokens);
+bool jitc_parse_tokens(jitc_context_t* context, list_t* tokens);
 void* jitc_compile_func(jitc_context_t* context, jitc_ast_t* ast, int* size);
 void jitc_compile(jitc_context_t* context, jitc_ast_t* ast);
+jitc_func_trampoline_t* jitc_relocate_function(jitc_context_t* context, jitc_func_trampoline_t* func, map_t* copies);
 void jitc_link(jitc_context_t* context);
 
-void jitc_destroy_ast(jitc_ast_t* ast);
 void jitc_delete_memchunks(jitc_context_t* context);
 
 void jitc_gdb_map_function(void* from, void* to, const char* name);
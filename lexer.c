@@ -2,6 +2,7 @@
 #include "dynamics.h"
 
 #include <math.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -31,6 +32,186 @@ static bool is_blank(char c) {
     return c == ' ' || c == '\t' || c == '\n';
 }
 
+#define KEYWORD_HASH_BITS 8
+#define KEYWORD_HASH_ATTEMPTS 65536
+
+#define KEYWORD_ENTRY(x) { #x, sizeof(#x) - 1, TOKEN_##x },
+#define KEYWORD_IGNORE(...)
+
+static const struct {
+    const char* name;
+    size_t length;
+    jitc_token_type_t type;
+} keywords[] = { TOKENS(KEYWORD_ENTRY, KEYWORD_IGNORE, KEYWORD_IGNORE) };
+
+static struct {
+    uint64_t seed;
+    int8_t slots[1 << KEYWORD_HASH_BITS];
+} keyword_hash;
+
+static uint32_t keyword_slot(uint64_t seed, const char* str, size_t length) {
+    uint64_t key = length | (uint8_t)str[0] << 8 | (uint8_t)str[1] << 16 | (uint64_t)(uint8_t)str[length - 1] << 24;
+    return (key * seed) >> (64 - KEYWORD_HASH_BITS);
+}
+
+__attribute__((constructor))
+static void keyword_hash_init() {
+    uint64_t seed = 0x9E3779B97F4A7C15;
+    for (int attempt = 0; attempt < KEYWORD_HASH_ATTEMPTS; attempt++, seed += 0x2545F4914F6CDD1D) {
+        memset(keyword_hash.slots, -1, sizeof(keyword_hash.slots));
+        bool collision = false;
+        for (size_t i = 0; i < sizeof(keywords) / sizeof(*keywords) && !collision; i++) {
+            int8_t* slot = &keyword_hash.slots[keyword_slot(seed, keywords[i].name, keywords[i].length)];
+            if (*slot != -1) collision = true;
+            else *slot = i;
+        }
+        if (collision) continue;
+        keyword_hash.seed = seed;
+        return;
+    }
+    fprintf(stderr, "[JITC] No collision-free keyword hash seed found, two keywords share length and first two and last characters\n");
+    abort();
+}
+
+jitc_token_type_t jitc_keyword(const char* str, size_t length) {
+    if (length < 2) return TOKEN_IDENTIFIER;
+    int index = keyword_hash.slots[keyword_slot(keyword_hash.seed, str, length)];
+    if (index == -1 || keywords[index].length != length || memcmp(keywords[index].name, str, length) != 0) return TOKEN_IDENTIFIER;
+    return keywords[index].type;
+}
+
+static struct {
+    int count;
+    jitc_token_type_t types[8];
+} symbol_buckets[128];
+
+__attribute__((constructor))
+static void symbol_buckets_init() {
+    for (int i = 0; i < num_token_table_entries; i++) {
+        if (!token_table[i] || !is_symbol(token_table[i][0])) continue;
+        typeof(*symbol_buckets)* bucket = &symbol_buckets[(uint8_t)token_table[i][0]];
+        if (bucket->count == sizeof(bucket->types) / sizeof(*bucket->types)) {
+            fprintf(stderr, "[JITC] Too many symbol tokens starting with '%c'\n", token_table[i][0]);
+            abort();
+        }
+        bucket->types[bucket->count++] = i;
+    }
+}
+
+static void match_symbol(string_t* buffer, int* starts_with, int* exact_match) {
+    const char* str = str_data(buffer);
+    size_t length = str_length(buffer);
+    *starts_with = 0;
+    if (length == 0) {
+        *starts_with = num_token_table_entries;
+        return;
+    }
+    typeof(*symbol_buckets)* bucket = &symbol_buckets[(uint8_t)str[0] & 127];
+    for (int i = 0; i < bucket->count; i++) {
+        const char* symbol = token_table[bucket->types[i]];
+        if (strncmp(str, symbol, length) != 0) continue;
+        (*starts_with)++;
+        if (symbol[length] == 0) *exact_match = bucket->types[i];
+    }
+}
+
+typedef size_t(*scanner_t)(const char* str, size_t length);
+typedef size_t(*until_scanner_t)(const char* str, size_t length, const char* stop);
+
+static size_t scalar_blank(const char* str, size_t length) {
+    size_t n = 0;
+    while (n < length && (str[n] == ' ' || str[n] == '\t')) n++;
+    return n;
+}
+
+static size_t scalar_word(const char* str, size_t length) {
+    size_t n = 0;
+    while (n < length && is_alphanumeric(str[n])) n++;
+    return n;
+}
+
+static size_t scalar_digits(const char* str, size_t length) {
+    size_t n = 0;
+    while (n < length && is_number(str[n])) n++;
+    return n;
+}
+
+static size_t scalar_until(const char* str, size_t length, const char* stop) {
+    size_t n = 0;
+    while (n < length && str[n] != stop[0] && str[n] != stop[1] && str[n] != stop[2]) n++;
+    return n;
+}
+
+#ifdef __x86_64__
+#include <immintrin.h>
+
+#define SIMD_CLASSIFIERS(isa, prefix, bits) \
+    __attribute__((target(#isa))) static inline __m##bits##i isa##_range(__m##bits##i x, char lo, char hi) { \
+        __m##bits##i t = prefix##_sub_epi8(x, prefix##_set1_epi8(lo)); \
+        return prefix##_cmpeq_epi8(prefix##_min_epu8(t, prefix##_set1_epi8(hi - lo)), t); \
+    } \
+    __attribute__((target(#isa))) static inline __m##bits##i isa##_blank_mask(__m##bits##i x) { \
+        return prefix##_or_si##bits(prefix##_cmpeq_epi8(x, prefix##_set1_epi8(' ')), prefix##_cmpeq_epi8(x, prefix##_set1_epi8('\t'))); \
+    } \
+    __attribute__((target(#isa))) static inline __m##bits##i isa##_word_mask(__m##bits##i x) { \
+        return prefix##_or_si##bits( \
+            prefix##_or_si##bits(isa##_range(prefix##_or_si##bits(x, prefix##_set1_epi8(0x20)), 'a', 'z'), isa##_range(x, '0', '9')), \
+            prefix##_or_si##bits(prefix##_cmpeq_epi8(x, prefix##_set1_epi8('_')), prefix##_cmpeq_epi8(x, prefix##_set1_epi8('$'))) \
+        ); \
+    } \
+    __attribute__((target(#isa))) static inline __m##bits##i isa##_digits_mask(__m##bits##i x) { \
+        return isa##_range(x, '0', '9'); \
+    } \
+    __attribute__((target(#isa))) static inline __m##bits##i isa##_until_mask(__m##bits##i x, const char* stop) { \
+        return prefix##_or_si##bits(prefix##_cmpeq_epi8(x, prefix##_set1_epi8(stop[0])), \
+            prefix##_or_si##bits(prefix##_cmpeq_epi8(x, prefix##_set1_epi8(stop[1])), prefix##_cmpeq_epi8(x, prefix##_set1_epi8(stop[2]))) \
+        ); \
+    }
+
+#define SIMD_SCANNER(isa, prefix, bits, name, span, ...) \
+    __attribute__((target(#isa))) static size_t isa##_##name(const char* str, size_t length __VA_OPT__(, const char* __VA_ARGS__)) { \
+        size_t n = 0; \
+        for (; n + bits / 8 <= length; n += bits / 8) { \
+            uint32_t mask = prefix##_movemask_epi8(isa##_##name##_mask(prefix##_loadu_si##bits((const void*)(str + n)) __VA_OPT__(, __VA_ARGS__))); \
+            if (span) mask = ~mask & (uint32_t)((1ull << (bits / 8)) - 1); \
+            if (mask) return n + __builtin_ctz(mask); \
+        } \
+        return n + scalar_##name(str + n, length - n __VA_OPT__(, __VA_ARGS__)); \
+    }
+
+#define SIMD_SCANNERS(isa, prefix, bits) \
+    SIMD_CLASSIFIERS(isa, prefix, bits) \
+    SIMD_SCANNER(isa, prefix, bits, blank, true) \
+    SIMD_SCANNER(isa, prefix, bits, word, true) \
+    SIMD_SCANNER(isa, prefix, bits, digits, true) \
+    SIMD_SCANNER(isa, prefix, bits, until, false, stop)
+
+SIMD_SCANNERS(sse2, _mm, 128)
+SIMD_SCANNERS(avx2, _mm256, 256)
+#endif
+
+static struct {
+    scanner_t blank, word, digits;
+    until_scanner_t until;
+} scan = { scalar_blank, scalar_word, scalar_digits, scalar_until };
+
+__attribute__((constructor))
+static void scan_init() {
+    if (getenv("JITC_SCALAR_LEXER")) return;
+#ifdef __x86_64__
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) scan = (typeof(scan)){ avx2_blank, avx2_word, avx2_digits, avx2_until };
+    else scan = (typeof(scan)){ sse2_blank, sse2_word, sse2_digits, sse2_until };
+#endif
+}
+
+#define skip_run(scanner, ...) ({ \
+    size_t _n = scanner(code + ptr, end - ptr __VA_OPT__(,) __VA_ARGS__); \
+    ptr += _n; \
+    col += _n; \
+    _n; \
+})
+
 static bool get_octal(char c, int* out) {
     if (c >= '0' && c <= '7') *out = c - '0';
     else return false;
@@ -199,28 +380,27 @@ static bool try_parse_flt(string_t* string, double* out, jitc_token_flags_t* fla
     return (!hex && (state == Integer || state == Fraction || state == Exponent)) || (hex && state == Exponent);
 }
 
-static jitc_token_t* mktoken(queue_t* _tokens, jitc_token_type_t type, const char* filename, int row, int col) {
-    queue(jitc_token_t)* tokens = _tokens;
-    jitc_token_t* token = &queue_push(tokens);
+static jitc_token_t* mktoken(list_t* _tokens, jitc_token_type_t type, const char* filename, int row, int col) {
+    list(jitc_token_t)* tokens = _tokens;
+    jitc_token_t* token = &list_add(tokens);
     token->type = type;
     token->filename = (char*)filename;
     token->row = row;
     token->col = col;
-    token->num_locations = 1;
+    token->expansion = 0;
     token->disabled = false;
     return token;
 }
 
-queue_t* jitc_lex(jitc_context_t* context, const char* code, const char* filename) {
+list_t* jitc_lex_from(jitc_context_t* context, const char* code, size_t end, const char* filename, int first_row) {
     char c;
     size_t ptr = 0;
     bool no_increment = false;
-    bool zero = false;
     bool asterisk = false;
     int digit = 0;
-    int row = 1, col = 0;
+    int row = first_row, col = 0;
     char* file = jitc_append_string(context, filename);
-    smartptr(queue(jitc_token_t)) tokens = queue_new(jitc_token_t);
+    smartptr(list(jitc_token_t)) tokens = list_new(jitc_token_t);
     struct {
         enum State {
             Idle,
@@ -233,6 +413,7 @@ queue_t* jitc_lex(jitc_context_t* context, const char* code, const char* filenam
             ParsingMultilineComment
         } parse_state;
         string_t* buffer;
+        size_t start;
         int row, col;
         bool first_token_on_line;
         bool preprocessor;
@@ -240,6 +421,7 @@ queue_t* jitc_lex(jitc_context_t* context, const char* code, const char* filenam
         union {
             struct {
                 bool angled;
+                bool sliced;
                 int num_digits;
                 uint32_t value;
                 enum {
@@ -263,8 +445,9 @@ queue_t* jitc_lex(jitc_context_t* context, const char* code, const char* filenam
     memset(&state, 0, sizeof(state));
     _buffer = state.buffer = str_new();
     state.first_token_on_line = true;
-    while (ptr == 0 || code[ptr - 1]) {
-        c = code[no_increment ? ptr - 1 : ptr++];
+    while (ptr == 0 || (ptr - 1 < end && code[ptr - 1])) {
+        size_t index = no_increment ? ptr - 1 : ptr++;
+        c = index < end ? code[index] : 0;
         if (c == 0) c = '\n'; // basically inserts a new line at the end of files
         if (c == '\n') {
             state.first_token_on_line = true;
@@ -281,25 +464,35 @@ queue_t* jitc_lex(jitc_context_t* context, const char* code, const char* filenam
         no_increment = false;
         if (state.parse_state == ParsingComment) {
             if (c == '\n') state.parse_state = Idle;
+            else skip_run(scan.until, "\n\n\n");
         }
         else if (state.parse_state == ParsingMultilineComment) {
             if (c == '/' && asterisk) state.parse_state = Idle;
             asterisk = c == '*';
+            if (state.parse_state == ParsingMultilineComment && !asterisk && c != '\n') skip_run(scan.until, "*\n\n");
         }
         else if (state.parse_state == Idle) {
             if      (c == '"' || (state.include && c == '<')) state.parse_state = ParsingStringLiteral;
             else if (c == '\'') state.parse_state = ParsingCharLiteral;
-            else if (is_number(c) || (c == '.' && is_number(code[ptr]))) state.parse_state = ParsingNumber;
+            else if (is_number(c) || (c == '.' && ptr < end && is_number(code[ptr]))) state.parse_state = ParsingNumber;
             else if (is_letter(c)) state.parse_state = ParsingWord;
             else if (is_symbol(c)) state.parse_state = ParsingSymbol;
-            else if (is_blank (c)) continue;
+            else if (is_blank (c)) {
+                if (c != '\n') skip_run(scan.blank);
+                continue;
+            }
             else throw("Invalid codepoint: \\x%02x", c);
             str_clear(state.buffer);
             state.row = row;
             state.col = col;
+            state.start = ptr;
             state.string_state.state = state.parse_state == ParsingCharLiteral ? CharStart : None;
             state.string_state.angled = c == '<';
-            if (state.parse_state == ParsingWord || state.parse_state == ParsingNumber || state.parse_state == ParsingSymbol) no_increment = true;
+            state.string_state.sliced = state.parse_state == ParsingStringLiteral;
+            if (state.parse_state == ParsingWord || state.parse_state == ParsingNumber || state.parse_state == ParsingSymbol) {
+                state.start = ptr - 1;
+                no_increment = true;
+            }
             if (state.parse_state == ParsingNumber)
                 state.number_state.used_dot =
                 state.number_state.used_letter =
@@ -312,13 +505,18 @@ queue_t* jitc_lex(jitc_context_t* context, const char* code, const char* filenam
                     if (c == '\'') throw("Empty char literal");
                     state.string_state.state = None;
                 case None:
-                    if (c == '\\') state.string_state.state = Backslash;
+                    if (c == '\\') {
+                        if (state.string_state.sliced) str_append_n(state.buffer, code + state.start, ptr - 1 - state.start);
+                        state.string_state.sliced = false;
+                        state.string_state.state = Backslash;
+                    }
                     else if ((
                         (!state.string_state.angled && c == '"') ||
                         ( state.string_state.angled && c == '>')
                     ) && state.parse_state == ParsingStringLiteral) {
                         jitc_token_t* token = mktoken(tokens, TOKEN_STRING, file, state.row, state.col);
-                        token->value.string = jitc_append_string(context, str_data(state.buffer));
+                        if (state.string_state.sliced) token->value.string = jitc_append_string_n(context, code + state.start, ptr - 1 - state.start);
+                        else token->value.string = jitc_append_string(context, str_data(state.buffer));
                         state.parse_state = Idle;
                     }
                     else if (c == '\'' && state.parse_state == ParsingCharLiteral) {
@@ -331,7 +529,14 @@ queue_t* jitc_lex(jitc_context_t* context, const char* code, const char* filenam
                         if (*data != 0) throw("Multiple characters in char literal");
                         state.parse_state = Idle;
                     }
-                    else str_append(state.buffer, (char[]){ c, 0 });
+                    else {
+                        if (!state.string_state.sliced) str_append(state.buffer, (char[]){ c, 0 });
+                        if (c == '\n') break;
+                        char stop[] = { state.parse_state == ParsingCharLiteral ? '\'' : state.string_state.angled ? '>' : '"', '\\', '\n' };
+                        const char* start = code + ptr;
+                        size_t length = skip_run(scan.until, stop);
+                        if (!state.string_state.sliced) str_append_n(state.buffer, start, length);
+                    }
                     break;
                 case Backslash:
                     state.string_state.num_digits = 0;
@@ -384,13 +589,13 @@ queue_t* jitc_lex(jitc_context_t* context, const char* code, const char* filenam
         }
         else if (state.parse_state == ParsingWord) {
             state.first_token_on_line = false;
-            if (is_alphanumeric(c)) str_append(state.buffer, (char[]){ c, 0 });
+            if (is_alphanumeric(c)) skip_run(scan.word);
             else {
-                char* buf = str_data(state.buffer);
-                if (strcmp(buf, "include") == 0 && state.preprocessor) state.include = true;
-                jitc_token_t* token = mktoken(tokens, TOKEN_IDENTIFIER, file, state.row, state.col + str_length(state.buffer) - strlen(buf));
-                token->value.string = jitc_append_string(context, buf);
-                buf[0] = 0;
+                const char* word = code + state.start;
+                size_t length = ptr - 1 - state.start;
+                if (state.preprocessor && length == 7 && memcmp(word, "include", 7) == 0) state.include = true;
+                jitc_token_t* token = mktoken(tokens, jitc_keyword(word, length), file, state.row, state.col);
+                token->value.string = jitc_append_string_n(context, word, length);
                 no_increment = true;
                 state.parse_state = Idle;
                 state.preprocessor = false;
@@ -421,9 +626,10 @@ queue_t* jitc_lex(jitc_context_t* context, const char* code, const char* filenam
                     c == 'E' || c == 'e' ||
                     c == 'P' || c == 'p'
                 )) state.number_state.just_used_letter = false;
-                str_append(state.buffer, (char[]){ c, 0 });
+                if (is_number(c)) skip_run(scan.digits);
             }
             else {
+                str_append_n(state.buffer, code + state.start, ptr - 1 - state.start);
                 jitc_token_t* token = mktoken(tokens, TOKEN_END_OF_FILE, file, state.row, state.col);
                 if      (try_parse_int(state.buffer, &token->value.integer,  &token->flags)) token->type = TOKEN_INTEGER;
                 else if (try_parse_flt(state.buffer, &token->value.floating, &token->flags)) token->type = TOKEN_FLOAT;
@@ -436,11 +642,7 @@ queue_t* jitc_lex(jitc_context_t* context, const char* code, const char* filenam
         else if (state.parse_state == ParsingSymbol) {
             int starts_with = 0;
             int exact_match = -1;
-            for (int i = 0; i < num_token_table_entries; i++) {
-                if (!token_table[i]) continue;
-                if (strncmp(str_data(state.buffer), token_table[i], str_length(state.buffer)) == 0) starts_with++;
-                if (strcmp(str_data(state.buffer), token_table[i]) == 0) exact_match = i;
-            }
+            match_symbol(state.buffer, &starts_with, &exact_match);
             if (exact_match != -1 && (starts_with == 1 || !is_symbol(c))) {
                 if (exact_match == TOKEN_COMMENT || exact_match == TOKEN_MULTILINE_COMMENT) {
                     state.parse_state = exact_match == TOKEN_COMMENT ? ParsingComment : ParsingMultilineComment;
@@ -455,11 +657,7 @@ queue_t* jitc_lex(jitc_context_t* context, const char* code, const char* filenam
             }
             if (is_symbol(c) && starts_with != 0) {
                 str_append(state.buffer, (char[]){ c, 0 });
-                starts_with = 0;
-                for (int i = 0; i < num_token_table_entries; i++) {
-                    if (!token_table[i]) continue;
-                    if (strncmp(str_data(state.buffer), token_table[i], str_length(state.buffer)) == 0) starts_with++;
-                }
+                match_symbol(state.buffer, &starts_with, (int[]){ -1 });
                 if (starts_with == 0 && exact_match != -1) {
                     if (exact_match == TOKEN_COMMENT || exact_match == TOKEN_MULTILINE_COMMENT) {
                         state.parse_state = exact_match == TOKEN_COMMENT ? ParsingComment : ParsingMultilineComment;
@@ -483,9 +681,12 @@ queue_t* jitc_lex(jitc_context_t* context, const char* code, const char* filenam
     return move(tokens);
 }
 
-jitc_token_t* jitc_token_expect(queue_t* _token_queue, jitc_token_type_t kind) {
-    queue(jitc_token_t)* token_queue = _token_queue;
-    jitc_token_t* token = &queue_peek(token_queue);
-    if (token->type == kind) return &queue_pop(token_queue);
+list_t* jitc_lex(jitc_context_t* context, const char* code, size_t end, const char* filename) {
+    return jitc_lex_from(context, code, end, filename, 1);
+}
+
+jitc_token_t* jitc_token_expect(jitc_token_stream_t* tokens, jitc_token_type_t kind) {
+    jitc_token_t* token = jitc_stream_peek(tokens);
+    if (token && token->type == kind) return jitc_stream_pop(tokens);
     return NULL;
 }
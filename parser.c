@@ -10,8 +10,8 @@
 #include <string.h>
 #include <dlfcn.h>
 
-#define NEXT_TOKEN (&queue_peek(tokens))
-#define throw_impl(...) jitc_error_set(context, jitc_error_parser(__VA_ARGS__))
+#define NEXT_TOKEN jitc_stream_peek(tokens)
+#define throw_impl(...) jitc_error_set(context, jitc_error_parser(context, __VA_ARGS__))
 
 // passed as "min_prec" into jitc_parse_expression
 // commas have precedence of 1
@@ -50,11 +50,15 @@ static struct {
 static jitc_ast_t* root_node = NULL;
 static jitc_ast_t* func_body_node = NULL;
 
-static jitc_ast_t* mknode(jitc_ast_type_t type, jitc_token_t* token) {
-    jitc_ast_t* ast = calloc(sizeof(jitc_ast_t), 1);
+// nodes are allocated at full size and retyped in place by folding, casts and method lookups, these retypes read across members
+_Static_assert(offsetof(jitc_ast_t, string.ptr) == offsetof(jitc_ast_t, integer.value) && sizeof(const char*) == sizeof(uint64_t), "a string literal cast to an integer keeps its address as the value");
+_Static_assert(offsetof(jitc_ast_t, floating.value) == offsetof(jitc_ast_t, integer.value) && sizeof(double) == sizeof(uint64_t), "constant initializer items are copied out of integer.value");
+
+static jitc_ast_t* mknode(jitc_context_t* context, jitc_ast_type_t type, jitc_token_t* token) {
+    jitc_ast_t* ast = memset(arena_alloc(context->parse_arena, sizeof(jitc_ast_t)), 0, sizeof(jitc_ast_t));
     ast->node_type = type;
     ast->token = token;
-    if (type == AST_List || type == AST_Scope) ast->list.inner = list_new(jitc_ast_t*);
+    if (type == AST_List || type == AST_Scope) ast->list.inner = arena_list_new(context->parse_arena, jitc_ast_t*);
     return ast;
 }
 
@@ -98,8 +102,7 @@ static bool is_lvalue(jitc_ast_t* ast) {
     return ast->node_type == AST_Variable || (ast->node_type == AST_Unary && ast->unary.operation == Unary_Dereference) || ast->node_type == AST_WalkStruct || ast->node_type == AST_Initializer;
 }
 
-bool jitc_peek_type(jitc_context_t* context, queue_t* _tokens) {
-    queue(jitc_token_t)* tokens = _tokens;
+bool jitc_peek_type(jitc_context_t* context, jitc_token_stream_t* tokens) {
     switch (NEXT_TOKEN->type) {
         case TOKEN_extern:
         case TOKEN_static:
@@ -134,8 +137,7 @@ bool jitc_peek_type(jitc_context_t* context, queue_t* _tokens) {
     }
 }
 
-bool jitc_parse_type_declarations(jitc_context_t* context, queue_t* _tokens, jitc_type_t** type) {
-    queue(jitc_token_t)* tokens = _tokens;
+bool jitc_parse_type_declarations(jitc_context_t* context, jitc_token_stream_t* tokens, jitc_type_t** type) {
     typedef struct {
         enum {
             DeclID_InnerDeclaration,
@@ -145,12 +147,12 @@ bool jitc_parse_type_declarations(jitc_context_t* context, queue_t* _tokens, jit
         jitc_token_t* starting_token;
         union {
             size_t array_size;
-            queue(jitc_token_t)* tokens;
+            jitc_token_stream_t tokens;
         };
     } declstack_t;
 
     if (!*type) return NULL;
-    if (queue_size(tokens) == 1) return true;
+    if (jitc_stream_size(tokens) == 1) return true;
     bool lhs_flag = true;
     jitc_token_t* token = NULL;
     smartptr(stack(declstack_t)) declstack = stack_new(declstack_t);
@@ -174,7 +176,7 @@ bool jitc_parse_type_declarations(jitc_context_t* context, queue_t* _tokens, jit
             jitc_token_t* starting_token = token;
             if (!jitc_token_expect(tokens, TOKEN_BRACKET_CLOSE)) {
                 token = NEXT_TOKEN;
-                smartptr(jitc_ast_t) ast = try(jitc_parse_expression(context, tokens, EXPR_NO_COMMAS, NULL));
+                jitc_ast_t* ast = try(jitc_parse_expression(context, tokens, EXPR_NO_COMMAS, NULL));
                 if (ast->node_type != AST_Integer) throw(token, "Expected integer constant");
                 size = ast->integer.value;
                 if (!jitc_token_expect(tokens, TOKEN_BRACKET_CLOSE)) throw(NEXT_TOKEN, "Expected ']'");
@@ -188,10 +190,9 @@ bool jitc_parse_type_declarations(jitc_context_t* context, queue_t* _tokens, jit
         else if ((token = jitc_token_expect(tokens, TOKEN_PARENTHESIS_OPEN))) {
             int depth = 0;
             jitc_token_t* starting_token = token;
-            smartptr(queue(jitc_token_t)) func = queue_new(jitc_token_t);
+            size_t start = jitc_stream_mark(tokens);
             while (true) {
-                token = &queue_pop(tokens);
-                queue_push(func) = *token;
+                token = jitc_stream_pop(tokens);
                 if (token->type == TOKEN_END_OF_FILE) throw(token, "Unexpected EOF");
                 if (token->type == TOKEN_PARENTHESIS_OPEN)  depth++;
                 if (token->type == TOKEN_PARENTHESIS_CLOSE) {
@@ -202,7 +203,7 @@ bool jitc_parse_type_declarations(jitc_context_t* context, queue_t* _tokens, jit
             stack_push(declstack) = (declstack_t){
                 .id = lhs_flag ? DeclID_InnerDeclaration : DeclID_Function,
                 .starting_token = starting_token,
-                .tokens = (void*)move(func)
+                .tokens = jitc_token_substream(tokens, start, jitc_stream_mark(tokens))
             };
             lhs_flag = false;
         }
@@ -220,20 +221,20 @@ bool jitc_parse_type_declarations(jitc_context_t* context, queue_t* _tokens, jit
             case DeclID_Function: {
                 jitc_token_t* comma = NULL;
                 smartptr(list(jitc_type_t*)) list = list_new(jitc_type_t*);
-                smartptr(queue(jitc_token_t)) queue = (void*)item->tokens;
+                jitc_token_stream_t* params = &item->tokens;
                 if (!jitc_validate_type(*type, TypePolicy_NoDerived)) throw(item->starting_token, "Function cannot return an array or function");
                 if (!jitc_validate_type(*type, TypePolicy_NoUndefTags)) *type = jitc_get_tagged_type(context, *type) ?: *type;
                 if (!jitc_validate_type(*type, TypePolicy_NoIncomplete & ~TypePolicy_NoVoid)) throw(item->starting_token, "Function returns an incomplete type");
-                while (queue_size(queue) > 1) {
+                while (jitc_stream_size(params) > 1) {
                     comma = NULL;
-                    token = &queue_peek(queue);
+                    token = jitc_stream_peek(params);
                     if (token->type == TOKEN_TRIPLE_DOT) {
-                        queue_pop(queue);
+                        jitc_stream_pop(params);
                         list_add(list) = jitc_typecache_primitive(context, Type_Varargs);
-                        if (!jitc_token_expect(queue, TOKEN_PARENTHESIS_CLOSE)) throw(&queue_pop(queue), "Expected ')'");
+                        if (!jitc_token_expect(params, TOKEN_PARENTHESIS_CLOSE)) throw(jitc_stream_pop(params), "Expected ')'");
                         break;
                     }
-                    jitc_type_t* param_type = jitc_typecache_decay(context, try(jitc_parse_type(context, queue, NULL, NULL)));
+                    jitc_type_t* param_type = jitc_typecache_decay(context, try(jitc_parse_type(context, params, NULL, NULL)));
                     if (param_type->kind == Type_Void) {
                         if (param_type->name) throw(token, "'void' cannot have a name");
                         if (list_size(list) > 0) throw(token, "'void' must be the only parameter");
@@ -242,15 +243,15 @@ bool jitc_parse_type_declarations(jitc_context_t* context, queue_t* _tokens, jit
                     if (!jitc_validate_type(param_type, TypePolicy_NoUndefTags)) param_type = jitc_get_tagged_type(context, param_type) ?: param_type;
                     if (!jitc_validate_type(param_type, TypePolicy_NoIncomplete)) throw(token, "Function parameter '%s' has incomplete type", param_type->name);
                     list_add(list) = param_type;
-                    comma = jitc_token_expect(queue, TOKEN_COMMA);
+                    comma = jitc_token_expect(params, TOKEN_COMMA);
                 }
-                if (queue_size(queue) > 1) throw(&queue_peek(queue), "Expected ')'");
+                if (jitc_stream_size(params) > 1) throw(jitc_stream_peek(params), "Expected ')'");
                 if (comma) throw(comma, "Expected type");
                 *type = jitc_typecache_function(context, *type, list);
             } break;
             case DeclID_InnerDeclaration: {
-                smartptr(queue(jitc_token_t)) inner_tokens = (void*)item->tokens;
-                if (queue_size(inner_tokens) == 1) throw(&queue_pop(inner_tokens), "Unexpected ')'");
+                jitc_token_stream_t* inner_tokens = &item->tokens;
+                if (jitc_stream_size(inner_tokens) == 1) throw(jitc_stream_pop(inner_tokens), "Unexpected ')'");
                 if (!jitc_parse_type_declarations(context, inner_tokens, type)) return false;
             } break;
         }
@@ -259,8 +260,7 @@ bool jitc_parse_type_declarations(jitc_context_t* context, queue_t* _tokens, jit
     return true;
 }
 
-jitc_type_t* jitc_parse_base_type(jitc_context_t* context, queue_t* _tokens, jitc_decltype_t* decltype, const char** extern_symbol, jitc_preserve_t* preserve_policy) {
-    queue(jitc_token_t)* tokens = _tokens;
+jitc_type_t* jitc_parse_base_type(jitc_context_t* context, jitc_token_stream_t* tokens, jitc_decltype_t* decltype, const char** extern_symbol, jitc_preserve_t* preserve_policy) {
     bool is_const = false, is_unsigned = false;
     jitc_specifiers_t specs = 0;
     jitc_token_t* token = NULL;
@@ -311,13 +311,13 @@ jitc_type_t* jitc_parse_base_type(jitc_context_t* context, queue_t* _tokens, jit
                 if (first_token) break;
                 throw(token, "Undefined type '%s'", token->value.string);
             }
-            type = jitc_typecache_named(context, variable->type, NULL);
-            queue_pop(tokens);
+            type = variable->type->unnamed;
+            jitc_stream_pop(tokens);
         }
         else if ((token = jitc_token_expect(tokens, TOKEN_typeof))) {
             if (!jitc_token_expect(tokens, TOKEN_PARENTHESIS_OPEN)) throw(NEXT_TOKEN, "Expected '('");
             if (jitc_peek_type(context, tokens)) type = try(jitc_parse_type(context, tokens, NULL, NULL));
-            else jitc_destroy_ast(try(jitc_parse_expression(context, tokens, EXPR_WITH_COMMAS, &type)));
+            else try(jitc_parse_expression(context, tokens, EXPR_WITH_COMMAS, &type));
             if (!jitc_token_expect(tokens, TOKEN_PARENTHESIS_CLOSE)) throw(NEXT_TOKEN, "Expected ')'");
         }
         else if ((token = jitc_token_expect(tokens, TOKEN_struct)) || (token = jitc_token_expect(tokens, TOKEN_union))) {
@@ -348,10 +348,10 @@ jitc_type_t* jitc_parse_base_type(jitc_context_t* context, queue_t* _tokens, jit
                     jitc_declare_variable(context, placeholder, Decltype_Typedef, NULL, 0, 0);
                 }
                 while (!jitc_token_expect(tokens, TOKEN_BRACE_CLOSE)) {
-                    while (NEXT_TOKEN->type == TOKEN_SEMICOLON) queue_pop(tokens);
+                    while (NEXT_TOKEN->type == TOKEN_SEMICOLON) jitc_stream_pop(tokens);
                     jitc_type_t* field_type = try(jitc_parse_base_type(context, tokens, NULL, NULL, NULL));
                     while (true) {
-                        field_type = jitc_typecache_named(context, field_type, NULL);
+                        field_type = field_type->unnamed;
                         try(jitc_parse_type_declarations(context, tokens, &field_type));
                         const char* field_name = field_type->name;
                         if (!jitc_validate_type(field_type, TypePolicy_NoUndefTags)) {
@@ -508,7 +508,7 @@ jitc_type_t* jitc_parse_base_type(jitc_context_t* context, queue_t* _tokens, jit
     return type;
 }
 
-jitc_type_t* jitc_parse_type(jitc_context_t* context, queue_t* tokens, jitc_decltype_t* decltype, jitc_preserve_t* preserve_policy) {
+jitc_type_t* jitc_parse_type(jitc_context_t* context, jitc_token_stream_t* tokens, jitc_decltype_t* decltype, jitc_preserve_t* preserve_policy) {
     jitc_type_t* type = NULL;
     if (!(type = jitc_parse_base_type(context, tokens, decltype, NULL, preserve_policy))) return NULL;
     if (!jitc_parse_type_declarations(context, tokens, &type)) return NULL;
@@ -596,8 +596,8 @@ jitc_ast_t* jitc_cast(jitc_context_t* context, jitc_ast_t* node, jitc_type_t* ty
             node->exprtype = jitc_typecache_pointer(context, node->exprtype);
             break;
         default: fallback: {
-            jitc_ast_t* cast = mknode(AST_Binary, node->token);
-            jitc_ast_t* type_node = mknode(AST_Type, node->token);
+            jitc_ast_t* cast = mknode(context, AST_Binary, node->token);
+            jitc_ast_t* type_node = mknode(context, AST_Type, node->token);
             type_node->type.type = type;
             cast->exprtype = type;
             cast->binary.operation = Binary_Cast;
@@ -638,8 +638,7 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
                 node->exprtype = variable->type;
             }
             else if (node->variable.templ_map) {
-                node->exprtype = jitc_typecache_fill_template(context, variable->type, node->variable.templ_map);
-                node->exprtype = jitc_mangle_template(context, node->exprtype, node->variable.templ_map);
+                node->exprtype = try(jitc_instantiate_template(context, variable->type, node->variable.templ_map));
                 node->variable.name = node->exprtype->name;
                 queue_push(context->instantiation_requests) = (jitc_instantiation_request_t){
                     .tokens = variable->ptr,
@@ -656,7 +655,7 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
             jitc_type_t* type;
             node->walk_struct.struct_ptr = try(jitc_process_ast(context, node->walk_struct.struct_ptr, &type));
             while (is_pointer(type)) {
-                jitc_ast_t* deref = mknode(AST_Unary, node->token);
+                jitc_ast_t* deref = mknode(context, AST_Unary, node->token);
                 deref->unary.operation = Unary_Dereference;
                 deref->unary.inner = node->walk_struct.struct_ptr;
                 deref->exprtype = type = type->ptr.base;
@@ -678,8 +677,9 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
                 node->walk_struct.field_name,
                 node->walk_struct.templ_list ? list_size(node->walk_struct.templ_list) : 0
             );
+            jitc_ast_t* this_ptr = node->walk_struct.struct_ptr;
             node->node_type = AST_Variable;
-            node->variable.this_ptr = node->walk_struct.struct_ptr;
+            node->variable.this_ptr = this_ptr;
             node->variable.name = method->type->name;
             node->variable.templ_map = template_map;
             node->variable.write_dest = false;
@@ -701,8 +701,8 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
                 if (node->unary.operation == Unary_AddressOf) {
                     if (node->unary.inner->node_type == AST_Unary && node->unary.inner->unary.operation == Unary_Dereference) {
                         jitc_ast_t* tmp = node->unary.inner->unary.inner;
-                        replace(node->unary.inner) = tmp;
-                        replace(node) = tmp;
+                        node->unary.inner = tmp;
+                        node = tmp;
                         break;
                     }
                     else node->exprtype = jitc_typecache_pointer(context, node->exprtype);
@@ -718,8 +718,8 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
                 node->unary.inner = try(jitc_process_ast(context, node->unary.inner, &node->exprtype));
                 if (node->unary.inner->node_type == AST_Unary && node->unary.inner->unary.operation == Unary_AddressOf) {
                     jitc_ast_t* tmp = node->unary.inner->unary.inner;
-                    replace(node->unary.inner) = tmp;
-                    replace(node) = tmp;
+                    node->unary.inner = tmp;
+                    node = tmp;
                 }
                 else {
                     if (!is_pointer(node->exprtype)) throw(node->token, "Operand must be a pointer type");
@@ -732,22 +732,22 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
             case Unary_ArithNegate:
                 node->unary.inner = try(jitc_process_ast(context, node->unary.inner, &node->exprtype));
                 if (!is_number(node->exprtype)) throw(node->token, "Operand must be a numeric type");
-                if (node->unary.operation == Unary_ArithPlus) replace(node) = node->unary.inner;
+                if (node->unary.operation == Unary_ArithPlus) node = node->unary.inner;
                 else {
                     if (node->unary.inner->node_type == AST_Integer) {
                         jitc_ast_t* inner = node->unary.inner;
                         inner->integer.value = -inner->integer.value;
-                        replace(node) = inner;
+                        node = inner;
                     }
                     else if (node->unary.inner->node_type == AST_Floating) {
                         jitc_ast_t* inner = node->unary.inner;
                         inner->floating.value = -inner->floating.value;
-                        replace(node) = inner;
+                        node = inner;
                     }
                     else if (node->unary.inner->node_type == AST_Unary && node->unary.inner->unary.operation == Unary_ArithNegate) {
                         jitc_ast_t* tmp = node->unary.inner->unary.inner;
-                        replace(node->unary.inner) = tmp;
-                        replace(node) = tmp;
+                        node->unary.inner = tmp;
+                        node = tmp;
                     }
                 }
                 break;
@@ -757,12 +757,12 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
                 if (is_constant(node->unary.inner)) {
                     jitc_ast_t* inner = node->unary.inner;
                     inner->integer.value = ~inner->integer.value;
-                    replace(node) = inner;
+                    node = inner;
                 }
                 else if (node->unary.inner->node_type == AST_Unary && node->unary.inner->unary.operation == Unary_BinaryNegate) {
                     jitc_ast_t* tmp = node->unary.inner->unary.inner;
-                    replace(node->unary.inner) = tmp;
-                    replace(node) = tmp;
+                    node->unary.inner = tmp;
+                    node = tmp;
                 }
                 break;
             case Unary_LogicNegate:
@@ -772,21 +772,20 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
                     jitc_ast_t* inner = node->unary.inner;
                     if (inner->unary.inner->node_type == AST_Unary && inner->unary.inner->unary.operation == Unary_LogicNegate) {
                         jitc_ast_t* tmp = inner->unary.inner->unary.inner;
-                        replace(inner->unary.inner) = tmp;
-                        replace(node->unary.inner) = tmp;
-                        replace(node) = tmp;
+                        inner->unary.inner = tmp;
+                        node->unary.inner = tmp;
+                        node = tmp;
                     }
                 }
                 if (is_constant(node->unary.inner)) {
                     jitc_ast_t* inner = node->unary.inner;
                     node->node_type = AST_Integer;
-                    node->integer.value = !(is_decayed_pointer(node->exprtype) ? 1 : node->unary.inner->node_type == AST_Floating
+                    node->integer.value = !(is_decayed_pointer(node->exprtype) ? 1 : inner->node_type == AST_Floating
                         ? inner->floating.value
                         : inner->integer.value
                     );
                     node->integer.type_kind = Type_Int8;
                     node->integer.is_unsigned = true;
-                    jitc_destroy_ast(inner);
                 }
                 node->exprtype = jitc_typecache_primitive(context, Type_Int8);
                 node->exprtype = jitc_typecache_unsigned(context, node->exprtype);
@@ -797,7 +796,7 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
             case Binary_Cast: {
                 jitc_ast_t* left = node->binary.left;
                 jitc_ast_t* right = node->binary.right;
-                replace(node) = try(jitc_cast(context,
+                node = try(jitc_cast(context,
                     try(jitc_process_ast(context, left, NULL)),
                     right->type.type, true, right->token
                 ));
@@ -812,14 +811,13 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
                 node->exprtype = func->func.ret;
                 if (has_varargs) num_fixed_args--;
                 if (node->binary.left->node_type == AST_Variable && node->binary.left->variable.this_ptr) {
-                    smartptr(list(jitc_ast_t*)) old_list = (void*)list;
-                    smartptr(list(jitc_ast_t*)) new_list = list_new(jitc_ast_t*);
-                    jitc_ast_t* addrof = mknode(AST_Unary, node->token);
+                    list(jitc_ast_t*)* new_list = arena_list_new(context->parse_arena, jitc_ast_t*);
+                    jitc_ast_t* addrof = mknode(context, AST_Unary, node->token);
                     addrof->unary.operation = Unary_AddressOf;
                     addrof->unary.inner = move(node->binary.left->variable.this_ptr);
                     list_add(new_list) = addrof;
-                    for (size_t i = 0; i < list_size(list); i++) list_add(new_list) = list_get(old_list, i);
-                    list = (void*)move(new_list);
+                    for (size_t i = 0; i < list_size(list); i++) list_add(new_list) = list_get(list, i);
+                    list = (void*)new_list;
                     node->binary.right->list.inner = (void*)list;
                 }
                 if (list_size(list) < num_fixed_args || (!has_varargs && list_size(list) != num_fixed_args)) throw(node->token,
@@ -864,8 +862,8 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
                 node->binary.left = try(jitc_cast(context, node->binary.left, node->exprtype, false, node->token)); \
                 node->binary.right = try(jitc_cast(context, node->binary.right, node->exprtype, false, node->token)); \
                 if (is_constant(node->binary.left) && is_constant(node->binary.right)) { \
-                    smartptr(jitc_ast_t) left = node->binary.left; \
-                    smartptr(jitc_ast_t) right = node->binary.right; \
+                    jitc_ast_t* left = node->binary.left; \
+                    jitc_ast_t* right = node->binary.right; \
                     if (is_floating(node->exprtype)) { \
                         node->node_type = AST_Floating; \
                         node->floating.is_single_precision = node->exprtype->kind == Type_Float32; \
@@ -887,8 +885,8 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
                 node->binary.left = try(jitc_cast(context, node->binary.left, node->exprtype, false, node->token)); \
                 node->binary.right = try(jitc_cast(context, node->binary.right, node->exprtype, false, node->token)); \
                 if (is_constant(node->binary.left) && is_constant(node->binary.right)) { \
-                    smartptr(jitc_ast_t) left = node->binary.left; \
-                    smartptr(jitc_ast_t) right = node->binary.right; \
+                    jitc_ast_t* left = node->binary.left; \
+                    jitc_ast_t* right = node->binary.right; \
                     node->node_type = AST_Integer; \
                     node->integer.type_kind = node->exprtype->kind; \
                     node->integer.is_unsigned = node->exprtype->is_unsigned; \
@@ -902,13 +900,13 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
                 node->binary.left = try(jitc_cast(context, node->binary.left, type, false, node->token)); \
                 node->binary.right = try(jitc_cast(context, node->binary.right, type, false, node->token)); \
                 if (is_constant(node->binary.left) && is_constant(node->binary.right)) { \
-                    smartptr(jitc_ast_t) left = node->binary.left; \
-                    smartptr(jitc_ast_t) right = node->binary.right; \
+                    jitc_ast_t* left = node->binary.left; \
+                    jitc_ast_t* right = node->binary.right; \
                     node->node_type = AST_Integer; \
                     node->integer.type_kind = Type_Int8; \
                     node->integer.is_unsigned = true; \
                     if (type->kind == Type_Float32 || type->kind == Type_Float64) \
-                        node->integer.value = left->floating.value op node->binary.right->floating.value; \
+                        node->integer.value = left->floating.value op right->floating.value; \
                     else { \
                         bool lneg = !left ->integer.is_unsigned && ((left ->integer.value >> 63) & 1); \
                         bool rneg = !right->integer.is_unsigned && ((right->integer.value >> 63) & 1); \
@@ -937,8 +935,8 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
                     : !node->binary.right->integer.value \
                 ); \
                 if ((lval == shortcircuit && lconst) || (rval == shortcircuit && rconst) || (lconst && rconst)) { \
-                    smartptr(jitc_ast_t) left = node->binary.left; \
-                    smartptr(jitc_ast_t) right = node->binary.right; \
+                    jitc_ast_t* left = node->binary.left; \
+                    jitc_ast_t* right = node->binary.right; \
                     node->node_type = AST_Integer; \
                     node->integer.value = lval op rval; \
                     node->integer.type_kind = Type_Int8; \
@@ -1002,7 +1000,7 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
             case Binary_Comma:
                 node->binary.left = try(jitc_process_ast(context, node->binary.left, NULL));
                 node->binary.right = try(jitc_process_ast(context, node->binary.right, &node->exprtype));
-                if (is_constant(node->binary.left)) replace(node) = node->binary.right;
+                if (is_constant(node->binary.left)) node = node->binary.right;
                 break;
             default: break;
         } break;
@@ -1016,11 +1014,7 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
                 bool cond = is_decayed_pointer(node->ternary.when->exprtype) ? 1 : node->ternary.when->node_type == AST_Floating
                     ? node->ternary.when->floating.value
                     : node->ternary.when->integer.value;
-                jitc_ast_t* result = cond ? node->ternary.then : node->ternary.otherwise;
-                jitc_destroy_ast(node->ternary.when);
-                jitc_destroy_ast(cond ? node->ternary.otherwise : node->ternary.then);
-                free(node);
-                node = result;
+                node = cond ? node->ternary.then : node->ternary.otherwise;
             }
         } break;
         default: break;
@@ -1029,48 +1023,42 @@ jitc_ast_t* jitc_process_ast(jitc_context_t* context, jitc_ast_t* ast, jitc_type
     return node;
 }
 
-jitc_ast_t* jitc_flatten_ast(jitc_ast_t* ast, list_t* _list) {
+jitc_ast_t* jitc_flatten_ast(jitc_context_t* context, jitc_ast_t* ast, list_t* _list) {
     list(jitc_ast_t*)* list = _list;
     if (!ast) return NULL;
     if (ast->node_type != AST_List && ast->node_type != AST_Scope) {
         if (ast->node_type == AST_Loop) {
-            ast->loop.cond = jitc_flatten_ast(ast->loop.cond, NULL);
-            ast->loop.body = jitc_flatten_ast(ast->loop.body, NULL);
+            ast->loop.cond = jitc_flatten_ast(context, ast->loop.cond, NULL);
+            ast->loop.body = jitc_flatten_ast(context, ast->loop.body, NULL);
         }
         else if (ast->node_type == AST_Branch) {
-            ast->ternary.when = jitc_flatten_ast(ast->ternary.when, NULL);
-            ast->ternary.then = jitc_flatten_ast(ast->ternary.then, NULL);
-            ast->ternary.otherwise = jitc_flatten_ast(ast->ternary.otherwise, NULL);
+            ast->ternary.when = jitc_flatten_ast(context, ast->ternary.when, NULL);
+            ast->ternary.then = jitc_flatten_ast(context, ast->ternary.then, NULL);
+            ast->ternary.otherwise = jitc_flatten_ast(context, ast->ternary.otherwise, NULL);
         }
         return ast;
     }
-    if (list && list_size(ast->list.inner) == 0) {
-        free(ast);
-        return NULL;
-    }
+    if (list && list_size(ast->list.inner) == 0) return NULL;
     if (list_size(ast->list.inner) == 1) {
         jitc_ast_t* inner = list_get(ast->list.inner, 0);
         if (inner->node_type == AST_Scope) {
-            jitc_ast_t* flattened = jitc_flatten_ast(inner, NULL);
+            jitc_ast_t* flattened = jitc_flatten_ast(context, inner, NULL);
             flattened->node_type = ast->node_type;
-            free(ast);
             return flattened;
         }
     }
     if (ast->node_type == AST_List && list) {
         for (size_t i = 0; i < list_size(ast->list.inner); i++) {
-            jitc_ast_t* child = jitc_flatten_ast(list_get(ast->list.inner, i), list);
+            jitc_ast_t* child = jitc_flatten_ast(context, list_get(ast->list.inner, i), list);
             if (child) list_add(list) = child;
         }
-        free(ast);
         return NULL;
     }
-    list(jitc_ast_t*)* new_list = list_new(jitc_ast_t*);
+    list(jitc_ast_t*)* new_list = arena_list_new(context->parse_arena, jitc_ast_t*);
     for (size_t i = 0; i < list_size(ast->list.inner); i++) {
-        jitc_ast_t* child = jitc_flatten_ast(list_get(ast->list.inner, i), new_list);
+        jitc_ast_t* child = jitc_flatten_ast(context, list_get(ast->list.inner, i), new_list);
         if (child) list_add(new_list) = child;
     }
-    list_delete(ast->list.inner);
     ast->list.inner = (void*)new_list;
     return ast;
 }
@@ -1160,16 +1148,135 @@ static int jitc_init_designate_struct(jitc_type_t* type, const char* name) {
     return ~offset;
 }
 
-jitc_ast_t* jitc_parse_initializer(jitc_context_t* context, queue_t* _tokens, jitc_token_t* token, jitc_type_t* type, size_t* array_size, bool constant_only) {
-    queue(jitc_token_t)* tokens = _tokens;
+static init_element_t* jitc_init_element(list_t* _elements, jitc_type_t* type, size_t item, size_t* offset) {
+    list(init_element_t)* elements = _elements;
+    size_t count = list_size(elements);
+    if (count == 0 || (item >= count && !(type->kind == Type_Array && type->arr.size == -1))) return NULL;
+    init_element_t* element = &list_get(elements, item % count);
+    *offset = element->offset + item / count * (type->kind == Type_Array ? type->arr.base->size : 0);
+    return element;
+}
+
+// constant items are written straight into one byte buffer, the first other item spills it into the item list
+typedef struct {
+    arena_t* arena;
+    uint8_t* data;
+    size_t size, capacity;
+    bool spilled;
+} init_bytes_t;
+
+static void jitc_init_reserve(init_bytes_t* bytes, size_t size) {
+    if (size <= bytes->size) return;
+    if (size > bytes->capacity) {
+        size_t capacity = bytes->capacity ? bytes->capacity : 64;
+        while (capacity < size) capacity *= 2;
+        bytes->data = bytes->data ? arena_realloc(bytes->arena, bytes->data, bytes->size, capacity) : arena_alloc(bytes->arena, capacity);
+        bytes->capacity = capacity;
+    }
+    memset(bytes->data + bytes->size, 0, size - bytes->size);
+    bytes->size = size;
+}
+
+static void jitc_init_write(init_bytes_t* bytes, size_t offset, const void* data, size_t size) {
+    jitc_init_reserve(bytes, offset + size);
+    memcpy(bytes->data + offset, data, size);
+}
+
+static jitc_ast_t* jitc_init_blob(jitc_context_t* context, jitc_token_t* token, void* data, size_t size) {
+    jitc_ast_t* blob = mknode(context, AST_Blob, token);
+    blob->blob.data = arena_alloc(context->parse_arena, sizeof(jitc_variable_t));
+    blob->blob.data->ptr = data;
+    blob->blob.size = size;
+    blob->exprtype = jitc_typecache_array(context, jitc_typecache_unsigned(context, jitc_typecache_primitive(context, Type_Int8)), size);
+    return blob;
+}
+
+static void jitc_init_store(jitc_context_t* context, jitc_ast_t* node, init_bytes_t* bytes, jitc_ast_t* item, size_t offset) {
+    if (!bytes->spilled) {
+        bool written = true;
+        if (item->node_type == AST_Blob) jitc_init_write(bytes, offset, item->blob.data->ptr, item->blob.size);
+        else if (item->node_type == AST_Floating && item->floating.is_single_precision) jitc_init_write(bytes, offset, &(float){item->floating.value}, sizeof(float));
+        else if (item->node_type == AST_Integer || item->node_type == AST_Floating) jitc_init_write(bytes, offset, &item->integer.value, item->exprtype->size);
+        else written = false;
+        if (written) return;
+        // the bytes so far go first, so the items after them still overwrite in source order
+        bytes->spilled = true;
+        if (bytes->size > 0) {
+            list_add(node->init.items) = jitc_init_blob(context, node->token, bytes->data, bytes->size);
+            list_add(node->init.offsets) = 0;
+        }
+    }
+    list_add(node->init.items) = item;
+    list_add(node->init.offsets) = offset;
+}
+
+static bool jitc_init_embed(jitc_context_t* context, jitc_ast_t* node, init_bytes_t* bytes, list_t* _elements, jitc_type_t* type, jitc_token_t* token, size_t* curr_item) {
+    list(init_element_t)* elements = _elements;
+    const char* data = token->value.embed->data;
+    size_t size = token->value.embed->size;
+    size_t i = 0;
+    while (i < size) {
+        size_t offset, next;
+        init_element_t* element = jitc_init_element(elements, type, *curr_item, &offset);
+        if (!element) break;
+        size_t run = 0;
+        while (i + run < size) {
+            init_element_t* byte = jitc_init_element(elements, type, *curr_item + run, &next);
+            if (!byte || byte->type->kind != Type_Int8 || next != offset + run) break;
+            run++;
+        }
+        if (run > 0) {
+            if (bytes->spilled) jitc_init_store(context, node, bytes, jitc_init_blob(context, token, (char*)data + i, run), offset);
+            else jitc_init_write(bytes, offset, data + i, run);
+            *curr_item += run;
+            i += run;
+            continue;
+        }
+        if (element->type->kind == Type_Array || is_struct(element->type))
+            throw(token, "Aggregate type with 0 elements must have an explicit initializer");
+        jitc_ast_t* byte = mknode(context, AST_Integer, token);
+        byte->integer.value = (uint8_t)data[i++];
+        byte->integer.type_kind = Type_Int32;
+        byte = try(jitc_process_ast(context, byte, NULL));
+        byte = try(jitc_cast(context, byte, element->type, false, token));
+        jitc_init_store(context, node, bytes, move(byte), offset);
+        do (*curr_item)++;
+        while (
+            list_get(elements, *curr_item % list_size(elements)).offset == element->offset &&
+            *curr_item % list_size(elements) != 0
+        );
+    }
+    return true;
+}
+
+static void jitc_init_finish(jitc_context_t* context, jitc_ast_t* node, init_bytes_t* bytes, size_t size, bool persist) {
+    list(jitc_ast_t*)* items = (void*)node->init.items;
+    if (!bytes->spilled && bytes->size > 0) {
+        // a blob covering the whole object lets locals skip zeroing it first
+        jitc_init_reserve(bytes, size);
+        list_add(items) = jitc_init_blob(context, node->token, bytes->data, bytes->size);
+        list_add(node->init.offsets) = 0;
+    }
+    // the bytes of local initializers are read by the generated code, so they outlive the parse
+    for (size_t i = 0; persist && i < list_size(items); i++) {
+        jitc_ast_t* item = list_get(items, i);
+        if (item->node_type != AST_Blob) continue;
+        void* data = arena_memdup(context->arena, item->blob.data->ptr, item->blob.size);
+        item->blob.data = arena_alloc(context->arena, sizeof(jitc_variable_t));
+        item->blob.data->ptr = data;
+    }
+}
+
+jitc_ast_t* jitc_parse_initializer(jitc_context_t* context, jitc_token_stream_t* tokens, jitc_token_t* token, jitc_type_t* type, size_t* array_size, bool constant_only) {
     smartptr(list(init_element_t)) elements = list_new(init_element_t);
     if (type) jitc_init_append(elements, type, 0, false);
     int cursor = 0;
 
-    smartptr(jitc_ast_t) node = mknode(AST_Initializer, token);
+    jitc_ast_t* node = mknode(context, AST_Initializer, token);
     node->init.type = type;
-    node->init.items = list_new(jitc_ast_t*);
-    node->init.offsets = list_new(size_t);
+    node->init.items = arena_list_new(context->parse_arena, jitc_ast_t*);
+    node->init.offsets = arena_list_new(context->parse_arena, size_t);
+    init_bytes_t bytes = { .arena = context->parse_arena };
     size_t curr_item = 0;
     if (array_size) *array_size = 0;
 
@@ -1189,7 +1296,7 @@ jitc_ast_t* jitc_parse_initializer(jitc_context_t* context, queue_t* _tokens, ji
             }
             else {
                 if (designator_type->kind != Type_Array) throw(token, "Initializer is not an array");
-                smartptr(jitc_ast_t) index = try(jitc_parse_expression(context, tokens, EXPR_NO_COMMAS, NULL));
+                jitc_ast_t* index = try(jitc_parse_expression(context, tokens, EXPR_NO_COMMAS, NULL));
                 if (!jitc_token_expect(tokens, TOKEN_BRACKET_CLOSE)) throw(token, "Expected ']'");
                 if (index->node_type != AST_Integer) throw(index->token, "Expected integer literal");
                 if (!index->integer.is_unsigned && (index->integer.value & (1L << 63))) throw(index->token, "Negative index");
@@ -1200,17 +1307,20 @@ jitc_ast_t* jitc_parse_initializer(jitc_context_t* context, queue_t* _tokens, ji
         if (has_designator && !jitc_token_expect(tokens, TOKEN_EQUALS)) throw(NEXT_TOKEN, "Expected '='");
         if (has_designator) curr_item = designator_offset;
         if (array_size) *array_size = curr_item / list_size(elements) + 1;
-        if ((token = jitc_token_expect(tokens, TOKEN_BRACE_OPEN))) {
+        if ((token = jitc_token_expect(tokens, TOKEN_EMBED))) {
+            try(jitc_init_embed(context, node, &bytes, elements, type, token, &curr_item));
+            if (array_size && curr_item > 0) *array_size = (curr_item - 1) / list_size(elements) + 1;
+        }
+        else if ((token = jitc_token_expect(tokens, TOKEN_BRACE_OPEN))) {
             init_element_t* element = curr_item >= list_size(elements)
                 ? type->kind == Type_Array && type->arr.size == -1
                     ? &list_get(elements, curr_item % list_size(elements))
                     : NULL
                 : &list_get(elements, curr_item);
-            smartptr(jitc_ast_t) inner = try(jitc_parse_initializer(context, tokens, token, element ? element->aggregate : NULL, NULL, constant_only));
-            if (element) for (size_t i = 0; i < list_size(inner->init.offsets); i++) {
-                list_add(node->init.items) = list_get(inner->init.items, 0);
-                list_add(node->init.offsets) = list_get(inner->init.offsets, i) + element->offset + element->aggregate->size * (curr_item / list_size(elements));
-                list_remove(inner->init.items, 0);
+            jitc_ast_t* inner = try(jitc_parse_initializer(context, tokens, token, element ? element->aggregate : NULL, NULL, constant_only));
+            if (element) for (size_t i = 0; i < list_size(inner->init.items); i++) {
+                size_t offset = list_get(inner->init.offsets, i) + element->offset + element->aggregate->size * (curr_item / list_size(elements));
+                jitc_init_store(context, node, &bytes, list_get(inner->init.items, i), offset);
             }
             curr_item += element ? jitc_init_num_elements(element->aggregate) : 0;
         }
@@ -1220,26 +1330,45 @@ jitc_ast_t* jitc_parse_initializer(jitc_context_t* context, queue_t* _tokens, ji
                     ? &list_get(elements, curr_item % list_size(elements))
                     : NULL
                 : &list_get(elements, curr_item);
-            smartptr(jitc_ast_t) expr = try(jitc_parse_expression(context, tokens, EXPR_NO_COMMAS, NULL));
-            if (element) {
-                if (element->type->kind == Type_Array || element->type->kind == Type_Struct || element->type->kind == Type_Union)
-                    throw(expr->token, "Aggregate type with 0 elements must have an explicit initializer");
-                bool is_aggregate = false;
-                if (!(expr = jitc_cast(context, expr, element->type, false, expr->token))) {
-                    jitc_error_set(context, NULL);
-                    expr = try(jitc_cast(context, expr, element->aggregate, false, expr->token));
-                    is_aggregate = true;
-                }
-                list_add(node->init.items) = move(expr);
-                list_add(node->init.offsets) = element->offset + curr_item / list_size(elements) * (type->kind == Type_Array ? type->arr.base->size : 0);
-                if (is_aggregate) curr_item += jitc_init_num_elements(element->aggregate);
-                else {
-                    int offset = element->offset;
-                    do curr_item++;
-                    while (
-                        list_get(elements, curr_item % list_size(elements)).offset == offset &&
-                        curr_item % list_size(elements) != 0
-                    );
+            jitc_token_t* literal = jitc_stream_peek(tokens);
+            jitc_token_t* after = tokens->ptr + 1 < tokens->end ? &tokens->tokens[tokens->ptr + 1] : NULL;
+            if (
+                element && !bytes.spilled && literal && after && literal->type == TOKEN_INTEGER &&
+                element->type->kind >= Type_Int8 && element->type->kind <= Type_Int64 &&
+                (after->type == TOKEN_COMMA || after->type == TOKEN_BRACE_CLOSE)
+            ) {
+                // plain integer tables skip the expression parser and never allocate a node
+                jitc_stream_pop(tokens);
+                size_t offset = element->offset + curr_item / list_size(elements) * (type->kind == Type_Array ? type->arr.base->size : 0);
+                jitc_init_write(&bytes, offset, &literal->value.integer, element->type->size);
+                int element_offset = element->offset;
+                do curr_item++;
+                while (
+                    list_get(elements, curr_item % list_size(elements)).offset == element_offset &&
+                    curr_item % list_size(elements) != 0
+                );
+            }
+            else {
+                jitc_ast_t* expr = try(jitc_parse_expression(context, tokens, EXPR_NO_COMMAS, NULL));
+                if (element) {
+                    if (element->type->kind == Type_Array || element->type->kind == Type_Struct || element->type->kind == Type_Union)
+                        throw(expr->token, "Aggregate type with 0 elements must have an explicit initializer");
+                    bool is_aggregate = false;
+                    if (!(expr = jitc_cast(context, expr, element->type, false, expr->token))) {
+                        jitc_error_set(context, NULL);
+                        expr = try(jitc_cast(context, expr, element->aggregate, false, expr->token));
+                        is_aggregate = true;
+                    }
+                    jitc_init_store(context, node, &bytes, move(expr), element->offset + curr_item / list_size(elements) * (type->kind == Type_Array ? type->arr.base->size : 0));
+                    if (is_aggregate) curr_item += jitc_init_num_elements(element->aggregate);
+                    else {
+                        int offset = element->offset;
+                        do curr_item++;
+                        while (
+                            list_get(elements, curr_item % list_size(elements)).offset == offset &&
+                            curr_item % list_size(elements) != 0
+                        );
+                    }
                 }
             }
         }
@@ -1247,34 +1376,37 @@ jitc_ast_t* jitc_parse_initializer(jitc_context_t* context, queue_t* _tokens, ji
         if (jitc_token_expect(tokens, TOKEN_BRACE_CLOSE)) break;
         throw(NEXT_TOKEN, "Expected ',' or '}'");
     }
+    size_t size = !array_size || !type ? 0 : type->kind == Type_Array && type->arr.size == -1
+        ? *array_size * type->arr.base->size
+        : type->size;
+    jitc_init_finish(context, node, &bytes, size, array_size && !constant_only);
     return move(node);
 }
 
-jitc_ast_t* jitc_parse_expression_operand(jitc_context_t* context, queue_t* _tokens) {
-    queue(jitc_token_t)* tokens = _tokens;
+jitc_ast_t* jitc_parse_expression_operand(jitc_context_t* context, jitc_token_stream_t* tokens) {
     jitc_token_t* token;
     bool force_parse_parentheses = false;
     smartptr(stack(jitc_ast_t*)) unary_stack = stack_new(jitc_ast_t*);
-    smartptr(jitc_ast_t) node = NULL;
+    jitc_ast_t* node = NULL;
     while (true) {
-        smartptr(jitc_ast_t) node = NULL;
-        if      ((token = jitc_token_expect(tokens, TOKEN_PLUS))) (node = mknode(AST_Unary, token))->unary.operation = Unary_ArithPlus;
-        else if ((token = jitc_token_expect(tokens, TOKEN_MINUS))) (node = mknode(AST_Unary, token))->unary.operation = Unary_ArithNegate;
-        else if ((token = jitc_token_expect(tokens, TOKEN_TILDE))) (node = mknode(AST_Unary, token))->unary.operation = Unary_BinaryNegate;
-        else if ((token = jitc_token_expect(tokens, TOKEN_EXCLAMATION_MARK))) (node = mknode(AST_Unary, token))->unary.operation = Unary_LogicNegate;
-        else if ((token = jitc_token_expect(tokens, TOKEN_ASTERISK))) (node = mknode(AST_Unary, token))->unary.operation = Unary_Dereference;
-        else if ((token = jitc_token_expect(tokens, TOKEN_AMPERSAND))) (node = mknode(AST_Unary, token))->unary.operation = Unary_AddressOf;
-        else if ((token = jitc_token_expect(tokens, TOKEN_DOUBLE_PLUS))) (node = mknode(AST_Unary, token))->unary.operation = Unary_PrefixIncrement;
-        else if ((token = jitc_token_expect(tokens, TOKEN_DOUBLE_MINUS))) (node = mknode(AST_Unary, token))->unary.operation = Unary_PrefixDecrement;
+        jitc_ast_t* node = NULL;
+        if      ((token = jitc_token_expect(tokens, TOKEN_PLUS))) (node = mknode(context, AST_Unary, token))->unary.operation = Unary_ArithPlus;
+        else if ((token = jitc_token_expect(tokens, TOKEN_MINUS))) (node = mknode(context, AST_Unary, token))->unary.operation = Unary_ArithNegate;
+        else if ((token = jitc_token_expect(tokens, TOKEN_TILDE))) (node = mknode(context, AST_Unary, token))->unary.operation = Unary_BinaryNegate;
+        else if ((token = jitc_token_expect(tokens, TOKEN_EXCLAMATION_MARK))) (node = mknode(context, AST_Unary, token))->unary.operation = Unary_LogicNegate;
+        else if ((token = jitc_token_expect(tokens, TOKEN_ASTERISK))) (node = mknode(context, AST_Unary, token))->unary.operation = Unary_Dereference;
+        else if ((token = jitc_token_expect(tokens, TOKEN_AMPERSAND))) (node = mknode(context, AST_Unary, token))->unary.operation = Unary_AddressOf;
+        else if ((token = jitc_token_expect(tokens, TOKEN_DOUBLE_PLUS))) (node = mknode(context, AST_Unary, token))->unary.operation = Unary_PrefixIncrement;
+        else if ((token = jitc_token_expect(tokens, TOKEN_DOUBLE_MINUS))) (node = mknode(context, AST_Unary, token))->unary.operation = Unary_PrefixDecrement;
         else if ((token = jitc_token_expect(tokens, TOKEN_PARENTHESIS_OPEN))) {
             if (!jitc_peek_type(context, tokens)) {
                 force_parse_parentheses = true;
                 break;
             }
-            smartptr(jitc_ast_t) type = mknode(AST_Type, token);
+            jitc_ast_t* type = mknode(context, AST_Type, token);
             type->type.type = try(jitc_parse_type(context, tokens, NULL, NULL));
             if (!jitc_token_expect(tokens, TOKEN_PARENTHESIS_CLOSE)) throw(NEXT_TOKEN, "Expected ')'");
-            node = mknode(AST_Binary, token);
+            node = mknode(context, AST_Binary, token);
             node->binary.operation = Binary_Cast;
             node->binary.right = move(type);
             // binary.left is filled later, its the same as unary.inner
@@ -1287,26 +1419,27 @@ jitc_ast_t* jitc_parse_expression_operand(jitc_context_t* context, queue_t* _tok
         if (!jitc_token_expect(tokens, TOKEN_PARENTHESIS_CLOSE)) throw(NEXT_TOKEN, "Expected ')'");
     }
     else if ((token = jitc_token_expect(tokens, TOKEN_INTEGER))) {
-        node = mknode(AST_Integer, token);
+        node = mknode(context, AST_Integer, token);
         node->integer.is_unsigned = token->flags.int_flags.is_unsigned;
         node->integer.type_kind = token->flags.int_flags.type_kind;
         node->integer.value = token->value.integer;
     }
     else if ((token = jitc_token_expect(tokens, TOKEN_FLOAT))) {
-        node = mknode(AST_Floating, token);
+        node = mknode(context, AST_Floating, token);
         node->floating.is_single_precision = token->flags.float_flags.is_single_precision;
         node->floating.value = token->value.floating;
     }
     else if ((token = jitc_token_expect(tokens, TOKEN_STRING))) {
-        node = mknode(AST_StringLit, token);
+        node = mknode(context, AST_StringLit, token);
         node->string.ptr = token->value.string;
     }
+    else if ((token = jitc_token_expect(tokens, TOKEN_EMBED))) throw(token, "#embed is only allowed inside an initializer");
     else if ((token = jitc_token_expect(tokens, TOKEN_IDENTIFIER))) {
         jitc_variable_t* variable = jitc_get_variable(context, token->value.string);
         if (!variable) throw(token, "Undefined variable '%s'", token->value.string);
         smartptr(map(char*, jitc_type_t*)) template_map = NULL;
         if (variable->type->kind == Type_Template) {
-            template_map = map_new(compare_string, char*, jitc_type_t*);
+            template_map = arena_map_new(context->parse_arena, compare_string, char*, jitc_type_t*);
             if (!jitc_token_expect(tokens, TOKEN_LESS_THAN)) throw(NEXT_TOKEN, "Expected '<'");
             for (int i = 0; i < variable->type->templ.num_names; i++) {
                 if (i != 0 && !jitc_token_expect(tokens, TOKEN_COMMA)) throw(NEXT_TOKEN, "Expected ','");
@@ -1316,24 +1449,24 @@ jitc_ast_t* jitc_parse_expression_operand(jitc_context_t* context, queue_t* _tok
             }
             if (!jitc_token_expect(tokens, TOKEN_GREATER_THAN)) throw(NEXT_TOKEN, "Expected '>'");
         }
-        node = mknode(AST_Variable, token);
+        node = mknode(context, AST_Variable, token);
         node->variable.name = jitc_scoped_name(context, token->value.string, variable->scope_id);
         node->variable.templ_map = move(template_map);
     }
     else if ((token = jitc_token_expect(tokens, TOKEN_true))) {
-        node = mknode(AST_Integer, token);
+        node = mknode(context, AST_Integer, token);
         node->integer.is_unsigned = true;
         node->integer.type_kind = Type_Int8;
         node->integer.value = true;
     }
     else if ((token = jitc_token_expect(tokens, TOKEN_false))) {
-        node = mknode(AST_Integer, token);
+        node = mknode(context, AST_Integer, token);
         node->integer.is_unsigned = true;
         node->integer.type_kind = Type_Int8;
         node->integer.value = false;
     }
     else if ((token = jitc_token_expect(tokens, TOKEN_nullptr))) {
-        node = mknode(AST_Integer, token);
+        node = mknode(context, AST_Integer, token);
         node->integer.is_unsigned = true;
         node->integer.type_kind = Type_Int64;
         node->integer.value = 0;
@@ -1342,14 +1475,14 @@ jitc_ast_t* jitc_parse_expression_operand(jitc_context_t* context, queue_t* _tok
         if (!jitc_token_expect(tokens, TOKEN_PARENTHESIS_OPEN)) throw(NEXT_TOKEN, "Expected '('");
         jitc_type_t* type = NULL;
         if (jitc_peek_type(context, tokens)) type = try(jitc_parse_type(context, tokens, NULL, NULL));
-        else jitc_destroy_ast(try(jitc_parse_expression(context, tokens, EXPR_WITH_COMMAS, &type)));
+        else try(jitc_parse_expression(context, tokens, EXPR_WITH_COMMAS, &type));
         if (!jitc_token_expect(tokens, TOKEN_PARENTHESIS_CLOSE)) throw(NEXT_TOKEN, "Expected ')'");
         if (!jitc_validate_type(type, TypePolicy_NoUndefTags)) {
             jitc_type_t* resolved = jitc_get_tagged_type(context, type);
             if (resolved) type = resolved;
             else throw(token, "Unresolved tagged type");
         }
-        node = mknode(AST_Integer, token);
+        node = mknode(context, AST_Integer, token);
         node->integer.is_unsigned = true;
         node->integer.type_kind = Type_Int64;
         node->integer.value = token->type == TOKEN_sizeof ? type->size : type->alignment;
@@ -1394,8 +1527,8 @@ jitc_ast_t* jitc_parse_expression_operand(jitc_context_t* context, queue_t* _tok
         func = jitc_typecache_named(context, func, lambda_name);
         jitc_declare_variable(context, jitc_typecache_named(context, func->func.ret, "return"), Decltype_None, NULL, 0, 0);
         jitc_ast_t* prev_func_node = func_body_node;
-        smartptr(jitc_ast_t) func_node = mknode(AST_Function, lambda_token);
-        smartptr(jitc_ast_t) func_body = func_body_node = mknode(AST_List, lambda_token);
+        jitc_ast_t* func_node = mknode(context, AST_Function, lambda_token);
+        jitc_ast_t* func_body = func_body_node = mknode(context, AST_List, lambda_token);
         if (jitc_token_expect(tokens, TOKEN_BRACE_OPEN)) {
             while (!jitc_token_expect(tokens, TOKEN_BRACE_CLOSE)) {
                 list_add(func_body->list.inner) = try(jitc_parse_statement(context, tokens, ParseType_Any));
@@ -1404,7 +1537,7 @@ jitc_ast_t* jitc_parse_expression_operand(jitc_context_t* context, queue_t* _tok
         else if (jitc_token_expect(tokens, TOKEN_ARROW)) {
             if (func->func.ret->kind == Type_Void) list_add(func_body->list.inner) = try(jitc_parse_expression(context, tokens, EXPR_WITH_COMMAS, NULL));
             else {
-                smartptr(jitc_ast_t) ret = mknode(AST_Return, token);
+                jitc_ast_t* ret = mknode(context, AST_Return, token);
                 ret->ret.expr = try(jitc_cast(context,
                     try(jitc_parse_expression(context, tokens, EXPR_WITH_COMMAS, NULL)),
                     func->func.ret, false, token
@@ -1417,7 +1550,7 @@ jitc_ast_t* jitc_parse_expression_operand(jitc_context_t* context, queue_t* _tok
         jitc_declare_variable(context, func, Decltype_Static, NULL, 0, 0);
         func_node->func.body = move(func_body);
         func_node->func.variable = func;
-        node = mknode(AST_Variable, lambda_token);
+        node = mknode(context, AST_Variable, lambda_token);
         node->variable.name = func->name;
         list_add(root_node->list.inner) = move(func_node);
         func_body_node = prev_func_node;
@@ -1428,16 +1561,16 @@ jitc_ast_t* jitc_parse_expression_operand(jitc_context_t* context, queue_t* _tok
         sprintf(compound_literal_name, "@c%016lx", compound_literal_counter++);
         char* name = jitc_append_string(context, compound_literal_name);
 
-        smartptr(jitc_ast_t) cast_node = stack_pop(unary_stack);
+        jitc_ast_t* cast_node = stack_pop(unary_stack);
         jitc_type_t* type = cast_node->binary.right->type.type;
         size_t array_size;
         node = try(jitc_parse_initializer(context, tokens, cast_node->token, type, &array_size, false));
-        node->init.store_to = mknode(AST_Variable, cast_node->token);
+        node->init.store_to = mknode(context, AST_Variable, cast_node->token);
         node->init.store_to->variable.name = name;
         node->init.store_to->variable.write_dest = true;
         if (type->kind == Type_Array && type->arr.size == -1) node->init.type = type = jitc_typecache_array(context, type->arr.base, array_size);
 
-        jitc_ast_t* decl = mknode(AST_Declaration, cast_node->token);
+        jitc_ast_t* decl = mknode(context, AST_Declaration, cast_node->token);
         decl->decl.decltype = Decltype_None;
         decl->decl.type = jitc_typecache_named(context, type, name);
         jitc_declare_variable(context, decl->decl.type, Decltype_None, NULL, Preserve_IfConst, 0);
@@ -1445,14 +1578,14 @@ jitc_ast_t* jitc_parse_expression_operand(jitc_context_t* context, queue_t* _tok
     }
     else throw(NEXT_TOKEN, "Expected expression");
     while (true) {
-        smartptr(jitc_ast_t) op = NULL;
+        jitc_ast_t* op = NULL;
         if ((token = jitc_token_expect(tokens, TOKEN_DOUBLE_PLUS))) {
-            op = mknode(AST_Unary, token);
+            op = mknode(context, AST_Unary, token);
             op->unary.operation = Unary_SuffixIncrement;
             op->unary.inner = move(node);
         }
         else if ((token = jitc_token_expect(tokens, TOKEN_DOUBLE_MINUS))) {
-            op = mknode(AST_Unary, token);
+            op = mknode(context, AST_Unary, token);
             op->unary.operation = Unary_SuffixDecrement;
             op->unary.inner = move(node);
         }
@@ -1460,10 +1593,11 @@ jitc_ast_t* jitc_parse_expression_operand(jitc_context_t* context, queue_t* _tok
             jitc_token_t* dot = token;
             smartptr(list(jitc_type_t*)) template_list = NULL;
             if (!(token = jitc_token_expect(tokens, TOKEN_IDENTIFIER))) throw(NEXT_TOKEN, "Expected identifier");
+            size_t mark = jitc_stream_mark(tokens);
             if (jitc_token_expect(tokens, TOKEN_LESS_THAN)) {
-                if (NEXT_TOKEN->type != TOKEN_GREATER_THAN && !jitc_peek_type(context, tokens)) queue_rollback(tokens);
+                if (NEXT_TOKEN->type != TOKEN_GREATER_THAN && !jitc_peek_type(context, tokens)) jitc_stream_reset(tokens, mark);
                 else {
-                    template_list = list_new(jitc_type_t*);
+                    template_list = arena_list_new(context->parse_arena, jitc_type_t*);
                     if (!jitc_token_expect(tokens, TOKEN_GREATER_THAN)) while (true) {
                         list_add(template_list) = try(jitc_parse_type(context, tokens, NULL, NULL));
                         if (jitc_token_expect(tokens, TOKEN_COMMA)) continue;
@@ -1473,35 +1607,35 @@ jitc_ast_t* jitc_parse_expression_operand(jitc_context_t* context, queue_t* _tok
                 }
             }
             if (dot->type == TOKEN_ARROW) {
-                jitc_ast_t* deref = mknode(AST_Unary, dot);
+                jitc_ast_t* deref = mknode(context, AST_Unary, dot);
                 deref->unary.operation = Unary_Dereference;
                 deref->unary.inner = move(node);
                 node = deref;
             }
-            op = mknode(AST_WalkStruct, dot);
+            op = mknode(context, AST_WalkStruct, dot);
             op->walk_struct.struct_ptr = move(node);
             op->walk_struct.templ_list = move(template_list);
             op->walk_struct.field_name = token->value.string;
         }
         else if ((token = jitc_token_expect(tokens, TOKEN_BRACKET_OPEN))) {
-            smartptr(jitc_ast_t) addition = mknode(AST_Binary, token);
+            jitc_ast_t* addition = mknode(context, AST_Binary, token);
             addition->binary.operation = Binary_Addition;
             addition->binary.left = move(node);
             addition->binary.right = try(jitc_parse_expression(context, tokens, EXPR_WITH_COMMAS, NULL));
             if (!jitc_token_expect(tokens, TOKEN_BRACKET_CLOSE)) throw(NEXT_TOKEN, "Expected ']'");
-            op = mknode(AST_Unary, token);
+            op = mknode(context, AST_Unary, token);
             op->unary.operation = Unary_Dereference;
             op->unary.inner = move(addition);
         }
         else if ((token = jitc_token_expect(tokens, TOKEN_PARENTHESIS_OPEN))) {
-            smartptr(jitc_ast_t) list = mknode(AST_List, token);
+            jitc_ast_t* list = mknode(context, AST_List, token);
             if (!jitc_token_expect(tokens, TOKEN_PARENTHESIS_CLOSE)) while (true) {
                 list_add(list->list.inner) = try(jitc_parse_expression(context, tokens, EXPR_NO_COMMAS, NULL));
                 if (jitc_token_expect(tokens, TOKEN_PARENTHESIS_CLOSE)) break;
                 if (jitc_token_expect(tokens, TOKEN_COMMA)) continue;
                 throw(NEXT_TOKEN, "Expected ')' or ','");
             }
-            op = mknode(AST_Binary, token);
+            op = mknode(context, AST_Binary, token);
             op->binary.operation = Binary_FunctionCall;
             op->binary.left = move(node);
             op->binary.right = move(list);
@@ -1555,23 +1689,22 @@ static struct {
     [TOKEN_COMMA]                      = { false, 1,  Binary_Comma },
 };
 
-jitc_ast_t* jitc_parse_expression(jitc_context_t* context, queue_t* _tokens, int min_prec, jitc_type_t** exprtype) {
-    queue(jitc_token_t)* tokens = _tokens;
-    smartptr(jitc_ast_t) left = try(jitc_parse_expression_operand(context, tokens));
+jitc_ast_t* jitc_parse_expression(jitc_context_t* context, jitc_token_stream_t* tokens, int min_prec, jitc_type_t** exprtype) {
+    jitc_ast_t* left = try(jitc_parse_expression_operand(context, tokens));
     while (true) {
         jitc_token_t* token = NEXT_TOKEN;
         int precedence = op_info[token->type].precedence;
         if (precedence < min_prec) break;
-        queue_pop(tokens);
+        jitc_stream_pop(tokens);
         if (token->type == TOKEN_QUESTION_MARK) {
             jitc_type_t *then_type, *else_type;
-            smartptr(jitc_ast_t) then_expr = try(jitc_parse_expression(context, tokens, precedence, &then_type));
+            jitc_ast_t* then_expr = try(jitc_parse_expression(context, tokens, precedence, &then_type));
             if (!jitc_token_expect(tokens, TOKEN_COLON)) throw(NEXT_TOKEN, "Expected ':'");
-            smartptr(jitc_ast_t) else_expr = try(jitc_parse_expression(context, tokens, precedence, &else_type));
+            jitc_ast_t* else_expr = try(jitc_parse_expression(context, tokens, precedence, &else_type));
             then_type = jitc_type_promotion(context, then_type, else_type, false);
             then_expr = try(jitc_cast(context, move(then_expr), then_type, false, token));
             else_expr = try(jitc_cast(context, move(else_expr), then_type, false, token));
-            jitc_ast_t* ternary = mknode(AST_Ternary, token);
+            jitc_ast_t* ternary = mknode(context, AST_Ternary, token);
             ternary->ternary.when = move(left);
             ternary->ternary.then = move(then_expr);
             ternary->ternary.otherwise = move(else_expr);
@@ -1580,7 +1713,7 @@ jitc_ast_t* jitc_parse_expression(jitc_context_t* context, queue_t* _tokens, int
             continue;
         }
         jitc_ast_t* right = try(jitc_parse_expression(context, tokens, precedence + !op_info[token->type].rtl_assoc, NULL));
-        jitc_ast_t* node = mknode(AST_Binary, token);
+        jitc_ast_t* node = mknode(context, AST_Binary, token);
         node->binary.operation = op_info[token->type].type;
         node->binary.left = move(left);
         node->binary.right = right;
@@ -1589,8 +1722,7 @@ jitc_ast_t* jitc_parse_expression(jitc_context_t* context, queue_t* _tokens, int
     return jitc_process_ast(context, move(left), exprtype);
 }
 
-jitc_ast_t* jitc_parse_parens(jitc_context_t* context, queue_t* _tokens) {
-    queue(jitc_token_t)* tokens = _tokens;
+jitc_ast_t* jitc_parse_parens(jitc_context_t* context, jitc_token_stream_t* tokens) {
     bool has_parens = jitc_token_expect(tokens, TOKEN_PARENTHESIS_OPEN);
     jitc_ast_t* node = try(jitc_parse_expression(context, tokens, EXPR_WITH_COMMAS, NULL));
     if (has_parens) {
@@ -1598,18 +1730,17 @@ jitc_ast_t* jitc_parse_parens(jitc_context_t* context, queue_t* _tokens) {
     }
     else {
         if (jitc_token_expect(tokens, TOKEN_EQUALS_ARROW)) (void)0;
-        else if (queue_peek(tokens).type == TOKEN_BRACE_OPEN) (void)0;
+        else if (NEXT_TOKEN->type == TOKEN_BRACE_OPEN) (void)0;
         else throw(NEXT_TOKEN, "Expected '=>' or '{'");
     }
     return node;
 }
 
-jitc_ast_t* jitc_parse_statement(jitc_context_t* context, queue_t* _tokens, jitc_parse_type_t allowed) {
-    queue(jitc_token_t)* tokens = _tokens;
+jitc_ast_t* jitc_parse_statement(jitc_context_t* context, jitc_token_stream_t* tokens, jitc_parse_type_t allowed) {
     jitc_token_t* token = NULL;
     if ((token = jitc_token_expect(tokens, TOKEN_if))) {
         if (!(allowed & ParseType_Command)) throw(token, "'if' not allowed here");
-        smartptr(jitc_ast_t) node = mknode(AST_Branch, token);
+        jitc_ast_t* node = mknode(context, AST_Branch, token);
         node->ternary.when = try(jitc_parse_parens(context, tokens));
         jitc_push_scope(context);
         node->ternary.then = try(jitc_parse_statement(context, tokens, ParseType_Command | ParseType_Expression));
@@ -1620,12 +1751,12 @@ jitc_ast_t* jitc_parse_statement(jitc_context_t* context, queue_t* _tokens, jitc
             jitc_pop_scope(context);
         }
         node = jitc_process_ast(context, move(node), NULL);
-        if (!node) return mknode(AST_List, token);
+        if (!node) return mknode(context, AST_List, token);
         return move(node);
     }
     if ((token = jitc_token_expect(tokens, TOKEN_while))) {
         if (!(allowed & ParseType_Command)) throw(token, "'while' not allowed here");
-        smartptr(jitc_ast_t) node = mknode(AST_Loop, token);
+        jitc_ast_t* node = mknode(context, AST_Loop, token);
         node->loop.cond = try(jitc_parse_parens(context, tokens));
         jitc_push_scope(context);
         node->loop.body = try(jitc_parse_statement(context, tokens, ParseType_Command | ParseType_Expression));
@@ -1634,17 +1765,17 @@ jitc_ast_t* jitc_parse_statement(jitc_context_t* context, queue_t* _tokens, jitc
     }
     if (jitc_token_expect(tokens, TOKEN_do)) {
         if (!(allowed & ParseType_Command)) throw(token, "'do' not allowed here");
-        smartptr(jitc_ast_t) node = mknode(AST_Scope, token);
-        smartptr(jitc_ast_t) loop = mknode(AST_Loop, token);
-        smartptr(jitc_ast_t) scope = mknode(AST_Scope, token);
+        jitc_ast_t* node = mknode(context, AST_Scope, token);
+        jitc_ast_t* loop = mknode(context, AST_Loop, token);
+        jitc_ast_t* scope = mknode(context, AST_Scope, token);
         list_add(scope->list.inner) = try(jitc_parse_statement(context, tokens, ParseType_Command | ParseType_Expression));
         if (!jitc_token_expect(tokens, TOKEN_while)) throw(NEXT_TOKEN, "Expected 'while'");
-        smartptr(jitc_ast_t) condition = try(jitc_parse_expression(context, tokens, EXPR_WITH_COMMAS, NULL));
+        jitc_ast_t* condition = try(jitc_parse_expression(context, tokens, EXPR_WITH_COMMAS, NULL));
         if (!jitc_token_expect(tokens, TOKEN_SEMICOLON)) throw(NEXT_TOKEN, "Expected ';'");
-        smartptr(jitc_ast_t) ternary = mknode(AST_Branch, token);
+        jitc_ast_t* ternary = mknode(context, AST_Branch, token);
         ternary->ternary.when = move(condition);
-        ternary->ternary.then = mknode(AST_List, token);
-        ternary->ternary.otherwise = mknode(AST_Break, token);
+        ternary->ternary.then = mknode(context, AST_List, token);
+        ternary->ternary.otherwise = mknode(context, AST_Break, token);
         list_add(scope->list.inner) = try(jitc_process_ast(context, move(ternary), NULL));
         ternary = NULL;
         loop->loop.body = move(scope);
@@ -1653,12 +1784,12 @@ jitc_ast_t* jitc_parse_statement(jitc_context_t* context, queue_t* _tokens, jitc
     }
     if (jitc_token_expect(tokens, TOKEN_for)) {
         if (!(allowed & ParseType_Command)) throw(token, "'for' not allowed here");
-        smartptr(jitc_ast_t) node = mknode(AST_Scope, token);
-        smartptr(jitc_ast_t) loop = mknode(AST_Loop, token);
-        smartptr(jitc_ast_t) body = mknode(AST_List, token);
-        smartptr(jitc_ast_t) init = NULL;
-        smartptr(jitc_ast_t) cond = NULL;
-        smartptr(jitc_ast_t) expr = NULL;
+        jitc_ast_t* node = mknode(context, AST_Scope, token);
+        jitc_ast_t* loop = mknode(context, AST_Loop, token);
+        jitc_ast_t* body = mknode(context, AST_List, token);
+        jitc_ast_t* init = NULL;
+        jitc_ast_t* cond = NULL;
+        jitc_ast_t* expr = NULL;
         jitc_push_scope(context);
         if (!jitc_token_expect(tokens, TOKEN_PARENTHESIS_OPEN)) throw(NEXT_TOKEN, "Expected '('");
         if (!jitc_token_expect(tokens, TOKEN_SEMICOLON))
@@ -1685,39 +1816,40 @@ jitc_ast_t* jitc_parse_statement(jitc_context_t* context, queue_t* _tokens, jitc
     if ((token = jitc_token_expect(tokens, TOKEN_continue))) {
         if (!(allowed & ParseType_Command)) throw(token, "'continue' not allowed here");
         if (!jitc_token_expect(tokens, TOKEN_SEMICOLON)) throw(NEXT_TOKEN, "Expected ';'");
-        return mknode(AST_Continue, token);
+        return mknode(context, AST_Continue, token);
     }
     if ((token = jitc_token_expect(tokens, TOKEN_break))) {
         if (!(allowed & ParseType_Command)) throw(token, "'break' not allowed here");
         if (!jitc_token_expect(tokens, TOKEN_SEMICOLON)) throw(NEXT_TOKEN, "Expected ';'");
-        return mknode(AST_Break, token);
+        return mknode(context, AST_Break, token);
     }
     if ((token = jitc_token_expect(tokens, TOKEN_interrupt))) {
         if (!(allowed & ParseType_Command)) throw(token, "'interrupt' not allowed here");
         if (!jitc_token_expect(tokens, TOKEN_SEMICOLON)) throw(NEXT_TOKEN, "Expected ';'");
-        return mknode(AST_Interrupt, token);
+        return mknode(context, AST_Interrupt, token);
     }
     if ((token = jitc_token_expect(tokens, TOKEN_goto))) {
         if (!(allowed & ParseType_Command)) throw(token, "'goto' not allowed here");
         if (!(token = jitc_token_expect(tokens, TOKEN_IDENTIFIER))) throw(NEXT_TOKEN, "Expected identifier");
-        smartptr(jitc_ast_t) node = mknode(AST_Goto, token);
+        jitc_ast_t* node = mknode(context, AST_Goto, token);
         node->label.name = token->value.string;
         if (!jitc_token_expect(tokens, TOKEN_SEMICOLON)) throw(NEXT_TOKEN, "Expected ';'");
         return move(node);
     }
+    size_t mark = jitc_stream_mark(tokens);
     if ((token = jitc_token_expect(tokens, TOKEN_IDENTIFIER))) {
         if (jitc_token_expect(tokens, TOKEN_COLON)) {
             if (!(allowed & ParseType_Command)) throw(token, "Label not allowed here");
-            jitc_ast_t* node = mknode(AST_Label, token);
+            jitc_ast_t* node = mknode(context, AST_Label, token);
             node->label.name = token->value.string;
             list_add(context->labels) = token->value.string;
             return node;
         }
-        else queue_rollback(tokens);
+        else jitc_stream_reset(tokens, mark);
     }
     if ((token = jitc_token_expect(tokens, TOKEN_return))) {
         if (!(allowed & ParseType_Command)) throw(token, "'return' not allowed here");
-        smartptr(jitc_ast_t) node = mknode(AST_Return, token);
+        jitc_ast_t* node = mknode(context, AST_Return, token);
         jitc_variable_t* retvar = jitc_get_variable(context, "return");
         if (retvar->type->kind != Type_Void) {
             node->ret.expr = try(jitc_cast(context,
@@ -1730,14 +1862,14 @@ jitc_ast_t* jitc_parse_statement(jitc_context_t* context, queue_t* _tokens, jitc
     }
     if ((token = jitc_token_expect(tokens, TOKEN_BRACE_OPEN))) {
         if (!(allowed & ParseType_Command)) throw(token, "Code block not allowed here");
-        smartptr(jitc_ast_t) node = mknode(AST_Scope, token);
+        jitc_ast_t* node = mknode(context, AST_Scope, token);
         jitc_push_scope(context);
         while (!jitc_token_expect(tokens, TOKEN_BRACE_CLOSE)) {
-            while (NEXT_TOKEN->type == TOKEN_SEMICOLON) queue_pop(tokens);
+            while (NEXT_TOKEN->type == TOKEN_SEMICOLON) jitc_stream_pop(tokens);
             list_add(node->list.inner) = try(jitc_parse_statement(context, tokens, ParseType_Any));
         }
         jitc_pop_scope(context);
-        return jitc_flatten_ast(move(node), NULL);
+        return jitc_flatten_ast(context, move(node), NULL);
     }
     if ((token = jitc_token_expect(tokens, TOKEN_EQUALS_ARROW))) {
         if (!(allowed & ParseType_Command)) throw(token, "Code block not allowed here");
@@ -1763,7 +1895,7 @@ jitc_ast_t* jitc_parse_statement(jitc_context_t* context, queue_t* _tokens, jitc
             }
         }
         token = NEXT_TOKEN;
-        smartptr(jitc_ast_t) list = mknode(AST_List, token);
+        jitc_ast_t* list = mknode(context, AST_List, token);
         const char* extern_symbol = NULL;
         jitc_decltype_t decltype = Decltype_None;
         jitc_preserve_t preserve_policy = Preserve_IfConst;
@@ -1772,7 +1904,7 @@ jitc_ast_t* jitc_parse_statement(jitc_context_t* context, queue_t* _tokens, jitc
         while (true) {
             jitc_type_t* type = base_type;
             jitc_ast_t* decl_node;
-            smartptr(jitc_ast_t) node = decl_node = template_list ? NULL : mknode(AST_Declaration, token);
+            jitc_ast_t* node = decl_node = template_list ? NULL : mknode(context, AST_Declaration, token);
             if (template_list) {
                 jitc_push_scope(context);
                 for (int i = 0; i < list_size(template_list); i++) {
@@ -1832,20 +1964,20 @@ jitc_ast_t* jitc_parse_statement(jitc_context_t* context, queue_t* _tokens, jitc
                     while (true) {
                         if (NEXT_TOKEN->type == TOKEN_END_OF_FILE) throw(NEXT_TOKEN, "Unexpected EOF");
                         if (level == 0 && NEXT_TOKEN->type == ending && ending != TOKEN_SEMICOLON) break;
-                        list_add(template_tokens) = queue_peek(tokens);
+                        list_add(template_tokens) = *NEXT_TOKEN;
                         if (level == 0 && NEXT_TOKEN->type == ending && ending == TOKEN_SEMICOLON) break;
                         if (NEXT_TOKEN->type == TOKEN_BRACE_OPEN)  level++;
                         if (NEXT_TOKEN->type == TOKEN_BRACE_CLOSE) level--;
-                        queue_pop(tokens);
+                        jitc_stream_pop(tokens);
                     }
-                    jitc_token_t eof_token = queue_pop(tokens);
+                    jitc_token_t eof_token = *jitc_stream_pop(tokens);
                     eof_token.type = TOKEN_END_OF_FILE;
                     list_add(template_tokens) = eof_token;
                     var->ptr = move(template_tokens);
                 }
                 else {
-                    smartptr(jitc_ast_t) func = mknode(AST_Function, token);
-                    smartptr(jitc_ast_t) body = func_body_node = mknode(AST_List, token);
+                    jitc_ast_t* func = mknode(context, AST_Function, token);
+                    jitc_ast_t* body = func_body_node = mknode(context, AST_List, token);
                     func->func.variable = type;
                     jitc_push_scope(context);
                     jitc_declare_variable(context, jitc_typecache_named(context, type->func.ret, "return"), Decltype_None, NULL, Preserve_IfConst, 0);
@@ -1855,7 +1987,7 @@ jitc_ast_t* jitc_parse_statement(jitc_context_t* context, queue_t* _tokens, jitc
                     if (token->type == TOKEN_ARROW) {
                         if (type->func.ret->kind == Type_Void) list_add(body->list.inner) = try(jitc_parse_expression(context, tokens, EXPR_WITH_COMMAS, NULL));
                         else {
-                            smartptr(jitc_ast_t) ret = mknode(AST_Return, token);
+                            jitc_ast_t* ret = mknode(context, AST_Return, token);
                             ret->ret.expr = try(jitc_cast(context,
                                 try(jitc_parse_expression(context, tokens, EXPR_WITH_COMMAS, NULL)),
                                 type->func.ret, false, token
@@ -1872,7 +2004,7 @@ jitc_ast_t* jitc_parse_statement(jitc_context_t* context, queue_t* _tokens, jitc
                         }
                     }
                     jitc_pop_scope(context);
-                    func->func.body = jitc_flatten_ast(move(body), NULL);
+                    func->func.body = jitc_flatten_ast(context, move(body), NULL);
                     try(jitc_verify_gotos(context, func->func.body));
                     list_add(list->list.inner) = move(func);
                 }
@@ -1886,9 +2018,9 @@ jitc_ast_t* jitc_parse_statement(jitc_context_t* context, queue_t* _tokens, jitc
                 jitc_token_t* equals_token = token;
                 if ((token = jitc_token_expect(tokens, TOKEN_BRACE_OPEN))) {
                     size_t arr_size;
-                    smartptr(jitc_ast_t) initializer = try(jitc_parse_initializer(context, tokens, token, type, &arr_size, list_size(context->scopes) == 1));
+                    jitc_ast_t* initializer = try(jitc_parse_initializer(context, tokens, token, type, &arr_size, list_size(context->scopes) == 1));
                     if (incomplete_array) type = jitc_typecache_named(context, jitc_typecache_array(context, type->arr.base, arr_size), type->name);
-                    jitc_ast_t* variable = mknode(AST_Variable, token);
+                    jitc_ast_t* variable = mknode(context, AST_Variable, token);
                     variable->variable.name = type->name;
                     variable->variable.write_dest = true;
                     initializer->init.store_to = variable;
@@ -1902,8 +2034,8 @@ jitc_ast_t* jitc_parse_statement(jitc_context_t* context, queue_t* _tokens, jitc
                 else if (incomplete_array) throw(NEXT_TOKEN, "Expected '{'");
                 else {
                     if (type->kind == Type_Array) throw(equals_token, "Assigning to an array");
-                    smartptr(jitc_ast_t) assign = mknode(AST_Binary, equals_token);
-                    smartptr(jitc_ast_t) variable = mknode(AST_Variable, equals_token);
+                    jitc_ast_t* assign = mknode(context, AST_Binary, equals_token);
+                    jitc_ast_t* variable = mknode(context, AST_Variable, equals_token);
                     variable->variable.name = type->name;
                     assign->binary.operation = Binary_AssignConst;
                     assign->binary.right = try(jitc_parse_expression(context, tokens, EXPR_NO_COMMAS, NULL));
@@ -1920,20 +2052,19 @@ jitc_ast_t* jitc_parse_statement(jitc_context_t* context, queue_t* _tokens, jitc
         }
         return move(list);
     }
-    if ((token = jitc_token_expect(tokens, TOKEN_SEMICOLON))) return mknode(AST_List, token);
+    if ((token = jitc_token_expect(tokens, TOKEN_SEMICOLON))) return mknode(context, AST_List, token);
     if (allowed & ParseType_Expression) {
-        smartptr(jitc_ast_t) node = try(jitc_parse_expression(context, tokens, true, NULL));
+        jitc_ast_t* node = try(jitc_parse_expression(context, tokens, true, NULL));
         if (!jitc_token_expect(tokens, TOKEN_SEMICOLON)) throw(NEXT_TOKEN, "Expected ';'");
         return move(node);
     }
     throw(NEXT_TOKEN, "Invalid statement");
 }
 
-jitc_ast_t* jitc_parse_ast(jitc_context_t* context, queue_t* _tokens) {
-    queue(jitc_token_t)* tokens = _tokens;
-    smartptr(jitc_ast_t) ast = root_node = mknode(AST_List, NEXT_TOKEN);
+jitc_ast_t* jitc_parse_ast(jitc_context_t* context, jitc_token_stream_t* tokens) {
+    jitc_ast_t* ast = root_node = mknode(context, AST_List, NEXT_TOKEN);
     while (!jitc_token_expect(tokens, TOKEN_END_OF_FILE)) {
-        while (NEXT_TOKEN->type == TOKEN_SEMICOLON) queue_pop(tokens);
+        while (NEXT_TOKEN->type == TOKEN_SEMICOLON) jitc_stream_pop(tokens);
         list_add(ast->list.inner) = try(jitc_parse_statement(context, tokens, ParseType_Declaration));
     }
     while (queue_size(context->instantiation_requests) > 0) {
@@ -1945,11 +2076,10 @@ jitc_ast_t* jitc_parse_ast(jitc_context_t* context, queue_t* _tokens) {
             jitc_declare_variable(context, type, Decltype_Extern, NULL, request->preserve_policy, 0);
             continue;
         }
-        list(jitc_token_t)* token_list = request->tokens;
-        smartptr(queue(jitc_token_t)) func_tokens = (void*)(tokens = queue_new(jitc_token_t));
-        smartptr(jitc_ast_t) func = mknode(AST_Function, NEXT_TOKEN);
-        smartptr(jitc_ast_t) body = func_body_node = mknode(AST_List, NEXT_TOKEN);
-        for (int i = 0; i < list_size(token_list); i++) queue_push(tokens) = list_get(token_list, i);
+        jitc_token_stream_t func_tokens = jitc_token_stream(request->tokens);
+        tokens = &func_tokens;
+        jitc_ast_t* func = mknode(context, AST_Function, NEXT_TOKEN);
+        jitc_ast_t* body = func_body_node = mknode(context, AST_List, NEXT_TOKEN);
         func->func.variable = type;
         jitc_push_scope(context);
         jitc_declare_variable(context, jitc_typecache_named(context, type->func.ret, "return"), Decltype_None, NULL, Preserve_IfConst, 0);
@@ -1964,67 +2094,13 @@ jitc_ast_t* jitc_parse_ast(jitc_context_t* context, queue_t* _tokens) {
             ), Decltype_Typedef, NULL, 0, 0);
         }
         while (!jitc_token_expect(tokens, TOKEN_END_OF_FILE)) {
-            while (NEXT_TOKEN->type == TOKEN_SEMICOLON) queue_pop(tokens);
+            while (NEXT_TOKEN->type == TOKEN_SEMICOLON) jitc_stream_pop(tokens);
             list_add(body->list.inner) = try(jitc_parse_statement(context, tokens, ParseType_Any));
         }
         jitc_pop_scope(context);
         jitc_declare_variable(context, type, request->decltype & ~Decltype_Template, NULL, request->preserve_policy, 0);
-        func->func.body = jitc_flatten_ast(move(body), NULL);
+        func->func.body = jitc_flatten_ast(context, move(body), NULL);
         list_add(ast->list.inner) = move(func);
     }
-    return jitc_flatten_ast(move(ast), NULL);
-}
-
-void jitc_destroy_ast(jitc_ast_t* ast) {
-    if (!ast) return;
-    switch (ast->node_type) {
-        case AST_Unary:
-            jitc_destroy_ast(ast->unary.inner);
-            break;
-        case AST_Binary:
-            jitc_destroy_ast(ast->binary.left);
-            jitc_destroy_ast(ast->binary.right);
-            break;
-        case AST_Ternary:
-        case AST_Branch:
-            jitc_destroy_ast(ast->ternary.when);
-            jitc_destroy_ast(ast->ternary.then);
-            jitc_destroy_ast(ast->ternary.otherwise);
-            break;
-        case AST_Scope:
-        case AST_List:
-            for (size_t i = 0; i < list_size(ast->list.inner); i++) {
-                jitc_destroy_ast(list_get(ast->list.inner, i));
-            }
-            list_delete(ast->list.inner);
-            break;
-        case AST_Function:
-            jitc_destroy_ast(ast->func.body);
-            break;
-        case AST_Loop:
-            jitc_destroy_ast(ast->loop.cond);
-            jitc_destroy_ast(ast->loop.body);
-            break;
-        case AST_Return:
-            jitc_destroy_ast(ast->ret.expr);
-            break;
-        case AST_WalkStruct:
-            jitc_destroy_ast(ast->walk_struct.struct_ptr);
-            if (ast->walk_struct.templ_list) list_delete(ast->walk_struct.templ_list);
-            break;
-        case AST_Initializer:
-            jitc_destroy_ast(ast->init.store_to);
-            for (size_t i = 0; i < list_size(ast->init.items); i++) {
-                jitc_destroy_ast(list_get(ast->init.items, i));
-            }
-            list_delete(ast->init.items);
-            list_delete(ast->init.offsets);
-            break;
-        case AST_Variable:
-            jitc_destroy_ast(ast->variable.this_ptr);
-            if (ast->variable.templ_map) map_delete(ast->variable.templ_map);
-            break;
-        default: break;
-    }
-    free(ast);
+    return jitc_flatten_ast(context, move(ast), NULL);
 }
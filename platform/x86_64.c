@@ -80,6 +80,7 @@ typedef enum: uint16_t {
     flip_modrm = (1 << 8),
     no_rax = (1 << 9),
     no_writeback = (1 << 10),
+    byte_regs = (1 << 11),
 
     modrm_op2 = modrm_op2_mask | has_modrm,
 } instr_flags_t;
@@ -260,6 +261,7 @@ static int opstack_int_index = 0, opstack_float_index = 0;
 static size_t rvalue_stack_ptr = 0;
 static size_t rvalue_stack_offset = 0;
 static size_t stack_bytes = 0;
+static list(jitc_reloc_t)* relocations = NULL;
 
 static void jitc_asm_call(bytewriter_t* writer, jitc_type_t* signature, jitc_type_t** arg_types, size_t num_args);
 static void jitc_asm_func(bytewriter_t* writer, jitc_type_t* signature, size_t stack_size);
@@ -409,6 +411,7 @@ static operand_t unptr(operand_t op1) {
 }
 
 static instr_flags_t get_extra_flags(instr_constraints_t constraints, jitc_type_kind_t type) {
+    if (type == Type_Int8) return byte_regs;
     if (type == Type_Int16) return force_size;
     if (type == Type_Int64 || type == Type_Pointer || type == Type_Float64) {
         if ((constraints & C_S64) && !(constraints & (C__S8 | C_S16 | C_S32))) return 0;
@@ -424,6 +427,14 @@ static void encode_instruction(bytewriter_t* writer, uint8_t opcode, reg_t reg1,
     if (op1 >= 8) rex |= 0x40 | 0b0001;
     if (op2 >= 8) rex |= 0x40 | 0b0100;
     if (flags & force_rexw) rex |= 0x48;
+    // without a rex prefix byte registers 4-7 are ah, ch, dh and bh instead of spl, bpl, sil and dil
+    if (flags & byte_regs) {
+        if (flags & modrm_opc) rex |= reg1 >= rsp && reg1 <= rdi ? 0x40 : 0;
+        else if (flags & has_modrm) {
+            if (mode == Mode_Reg && op1 >= rsp && op1 <= rdi) rex |= 0x40;
+            if (!(flags & modrm_op2_mask) && op2 >= rsp && op2 <= rdi) rex |= 0x40;
+        }
+    }
     if (flags & force_size) bytewriter_int8(writer, 0x66);
     if (flags & prefix_f3) bytewriter_int8(writer, 0xF3);
     if (flags & prefix_f2) bytewriter_int8(writer, 0xF2);
@@ -544,7 +555,9 @@ static void emit_instructions(bytewriter_t* writer, instr_t* instr, legalization
                 else if (mem->disp >= INT8_MIN && mem->disp <= INT8_MAX) mode = Mode_Disp8;
                 else mode = Mode_Disp32;
             }
-            emit_instruction(writer, instr, op1->reg, op1 == op2 || op2->type == OpType_imm ? rax : op2->reg, mode, get_extra_flags(instr->constraints[0], op1->kind));
+            instr_flags_t flags = get_extra_flags(instr->constraints[0], op1->kind);
+            if (op2->kind == Type_Int8 && op2->type != OpType_imm) flags |= byte_regs;
+            emit_instruction(writer, instr, op1->reg, op1 == op2 || op2->type == OpType_imm ? rax : op2->reg, mode, flags);
             if (mode == Mode_Disp8) bytewriter_int8(writer, op1->disp == 0 ? op2->disp : op1->disp);
             if (mode == Mode_Disp32) bytewriter_int32(writer, op1->disp == 0 ? op2->disp : op1->disp);
             if (op2->type == OpType_imm) {
@@ -879,7 +892,15 @@ static void jitc_asm_laddr(bytewriter_t* writer, jitc_variable_t* var, jitc_type
     operand_t op1 = op(push(writer, StackItem_lvalue_abs, kind, is_unsigned));
     operand_t res = unptr(op1);
     op1.kind = res.kind; op1.is_unsigned = res.is_unsigned;
+    size_t start = bytewriter_size(writer);
     emit(writer, mov, 2, res, imm((uint64_t)&var->ptr, Type_Pointer, true));
+    // the address may be staged through a temporary register, so it's located by value
+    uint8_t* code = bytewriter_data(writer);
+    for (size_t i = start; i + sizeof(void*) <= bytewriter_size(writer); i++) {
+        if (memcmp(code + i, &(void*){ &var->ptr }, sizeof(void*)) != 0) continue;
+        list_add(relocations) = (jitc_reloc_t){ i, var };
+        break;
+    }
     emit(writer, mov, 2, res, op1);
 }
 
@@ -1327,8 +1348,9 @@ static void stacksize_pop(stack_t* _stack, size_t* num_int_vars, size_t* num_flo
     }
 }
 
-static void jitc_asm_emit(bytewriter_t* writer, list_t* _ir) {
+static void jitc_asm_emit(bytewriter_t* writer, list_t* _ir, list_t* relocs) {
     list(jitc_ir_t)* ir = _ir;
+    relocations = (void*)relocs;
     size_t max_int_vars = 0, max_float_vars = 0;
     size_t num_int_vars = 0, num_float_vars = 0;
     smartptr(stack(stack_item_t)) stack = stack_new(stack_item_t);
@@ -7,7 +7,7 @@
 #include <stdlib.h>
 #include <time.h>
 
-#define throw_impl(token, ...) jitc_error_set(context, jitc_error_parser(token, "(Preprocessor) " __VA_ARGS__))
+#define throw_impl(token, ...) jitc_error_set(context, jitc_error_parser(context, token, "(Preprocessor) " __VA_ARGS__))
 
 typedef enum {
     MacroType_Ordinary,
@@ -32,7 +32,6 @@ typedef struct {
 
 #define number_token(val) (jitc_token_t){ \
     .type = TOKEN_INTEGER, \
-    .num_locations = 1, \
     .filename = "<builtin>", \
     .value.integer = val, \
     .flags.int_flags.type_kind = Type_Int32, \
@@ -41,14 +40,12 @@ typedef struct {
 
 #define string_token(val) (jitc_token_t){ \
     .type = TOKEN_STRING, \
-    .num_locations = 1, \
     .filename = "<builtin>", \
     .value.string = val, \
 }
 
 #define identifier_token(val) (jitc_token_t){ \
-    .type = TOKEN_IDENTIFIER, \
-    .num_locations = 1, \
+    .type = jitc_keyword(val, strlen(val)), \
     .filename = "<builtin>", \
     .value.string = val, \
 }
@@ -129,6 +126,18 @@ static jitc_token_t* lookahead(token_stream_t* tokens, int curr_line) {
     }
 }
 
+#define WORD_KEYWORD(x) [TOKEN_##x] = true,
+#define WORD_IGNORE(...)
+
+static const bool word_tokens[TOKEN_COUNT] = {
+    [TOKEN_IDENTIFIER] = true,
+    TOKENS(WORD_KEYWORD, WORD_IGNORE, WORD_IGNORE)
+};
+
+static bool is_word(jitc_token_t* token) {
+    return word_tokens[token->type];
+}
+
 static bool is_identifier(jitc_token_t* token, const char* id) {
     return
         (token->type == TOKEN_IDENTIFIER && strcmp(token->value.string, id) == 0) ||
@@ -173,13 +182,13 @@ static bool get_operand(jitc_context_t* context, map_t* macros, token_stream_t*
     if (is_identifier(token, "defined")) {
         token = expect_and(
             &list_get(stream->tokens, stream->ptr++),
-            this->type == TOKEN_IDENTIFIER || this->type == TOKEN_PARENTHESIS_OPEN,
+            is_word(this) || this->type == TOKEN_PARENTHESIS_OPEN,
             "Macro name expected"
         );
         const char* name = NULL;
-        if (token->type == TOKEN_IDENTIFIER) name = token->value.string;
+        if (is_word(token)) name = token->value.string;
         else if (token->type == TOKEN_PARENTHESIS_OPEN) {
-            token = expect_and(&list_get(stream->tokens, stream->ptr++), this->type == TOKEN_IDENTIFIER, "Macro name expected");
+            token = expect_and(&list_get(stream->tokens, stream->ptr++), is_word(this), "Macro name expected");
             name = token->value.string;
             token = expect_and(&list_get(stream->tokens, stream->ptr++), this->type == TOKEN_PARENTHESIS_CLOSE, "Expected ')'");
         }
@@ -191,7 +200,7 @@ static bool get_operand(jitc_context_t* context, map_t* macros, token_stream_t*
         try(compute_expression(context, macros, stream, value, 1));
         expect_and(&list_get(stream->tokens, stream->ptr++), this->type == TOKEN_PARENTHESIS_CLOSE, "Expected ')'");
     }
-    else if (token->type == TOKEN_IDENTIFIER) {
+    else if (is_word(token)) {
         // undefined macro
         *value = 0;
     }
@@ -299,12 +308,13 @@ static void expand(jitc_context_t* context, jitc_token_t* base, token_stream_t*
     smartptr(list(jitc_token_t)) list2 = list_new(jitc_token_t);
     token_stream_t stream1 = {(void*)list1};
     token_stream_t stream2 = {(void*)list2};
+    token_stream_t swap;
     bool expanded = false;
     while (tokens->ptr < list_size(tokens->tokens)) {
         jitc_token_t* token = &list_get(tokens->tokens, tokens->ptr++);
         bool va_opt = token->type == TOKEN_IDENTIFIER && strcmp(token->value.string, "__VA_OPT__") == 0;
         bool va_args = token->type == TOKEN_IDENTIFIER && strcmp(token->value.string, "__VA_ARGS__") == 0;
-        if (token->type == TOKEN_IDENTIFIER && args) {
+        if (is_word(token) && args) {
             if (va_opt && next_token(TOKEN_PARENTHESIS_OPEN)) {
                 int depth = 0;
                 while (tokens->ptr < list_size(tokens->tokens)) {
@@ -328,13 +338,12 @@ static void expand(jitc_context_t* context, jitc_token_t* base, token_stream_t*
     }
     do {
         expanded = false;
-        stream1.ptr = 0;
-        while (list_size(stream1.tokens) > 0) list_remove(stream1.tokens, list_size(stream1.tokens) - 1); // clear 1
-        for (int i = 0; i < list_size(stream2.tokens); i++) list_add(stream1.tokens) = list_get(stream2.tokens, i); // 2 -> 1
-        while (list_size(stream2.tokens) > 0) list_remove(stream2.tokens, list_size(stream2.tokens) - 1); // clear 2
+        swap = stream1; stream1 = stream2; stream2 = swap; // 2 -> 1
+        stream1.ptr = stream2.ptr = 0;
+        list_clear(stream2.tokens); // clear 2
         while (stream1.ptr < list_size(stream1.tokens)) { // process 1 -> 2
             jitc_token_t* token = &list_get(stream1.tokens, stream1.ptr++);
-            if (token->type == TOKEN_IDENTIFIER) {
+            if (is_word(token)) {
                 if (process_identifier(context, &stream2, &stream1, macros, used_macros, recurse_limit))
                     expanded = true;
             }
@@ -345,7 +354,7 @@ static void expand(jitc_context_t* context, jitc_token_t* base, token_stream_t*
     while (stream2.ptr < list_size(stream2.tokens)) { // 2 -> dest
         jitc_token_t token = list_get(stream2.tokens, stream2.ptr++);
         token.disabled = true;
-        jitc_push_location(&token, base->filename, base->row, base->col);
+        jitc_push_location(context, &token, base->filename, base->row, base->col);
         list_add(dest->tokens) = token;
     }
 }
@@ -408,6 +417,7 @@ static bool process_identifier(jitc_context_t* context, token_stream_t* dest, to
             list_add(dest->tokens) = string_token((char*)token->filename ?: "<memory>");
             break;
         case MacroType_DATE: {
+            if (context->recording) context->recording->uncacheable = true;
             struct tm* t = localtime((time_t[]){time(NULL)});
             char formatted[256];
             sprintf(formatted, "%s %2d %d", (const char*[]){
@@ -417,6 +427,7 @@ static bool process_identifier(jitc_context_t* context, token_stream_t* dest, to
             list_add(dest->tokens) = string_token(jitc_append_string(context, formatted));
         } break;
         case MacroType_TIME: {
+            if (context->recording) context->recording->uncacheable = true;
             struct tm* t = localtime((time_t[]){time(NULL)});
             char formatted[256];
             sprintf(formatted, "%02d:%02d:%02d", t->tm_hour, t->tm_min, t->tm_sec);
@@ -433,10 +444,11 @@ static bool process_identifier(jitc_context_t* context, token_stream_t* dest, to
                     if (next->type == TOKEN_PARENTHESIS_OPEN) depth++;
                     if (next->type == TOKEN_PARENTHESIS_CLOSE) depth--;
                     if (depth != 0) continue;
-                    if (next->type == TOKEN_IDENTIFIER) str_append(new_id, next->value.string);
+                    if (is_word(next)) str_append(new_id, next->value.string);
                     if (next->type == TOKEN_INTEGER) str_appendf(new_id, "%lu", next->value.integer);
                 }
-                jitc_token_t id_token = identifier_token(jitc_append_string(context, str_data(new_id)));
+                char* name = jitc_append_string(context, str_data(new_id));
+                jitc_token_t id_token = identifier_token(name);
                 id_token.row = token->row; id_token.col = token->col; id_token.filename = token->filename;
                 list_add(dest->tokens) = id_token;
             }
@@ -446,7 +458,64 @@ static bool process_identifier(jitc_context_t* context, token_stream_t* dest, to
     return true;
 }
 
-queue_t* jitc_preprocess(jitc_context_t* context, queue_t* _token_queue, map_t* _macros, list_t* _dependencies) {
+static bool embed_param(jitc_token_t* token, const char* name) {
+    if (!is_word(token)) return false;
+    const char* id = token->type == TOKEN_IDENTIFIER ? token->value.string : token_table[token->type];
+    size_t length = strlen(name);
+    if (strcmp(id, name) == 0) return true;
+    return strncmp(id, "__", 2) == 0 && strncmp(id + 2, name, length) == 0 && strcmp(id + 2 + length, "__") == 0;
+}
+
+static bool process_embed(jitc_context_t* context, token_stream_t* dest, token_stream_t* stream, int* curr_line, jitc_token_t* file, const char* filename, map_t* macros, bool do_things) {
+    smartptr(list(jitc_token_t)) prefix = list_new(jitc_token_t);
+    smartptr(list(jitc_token_t)) suffix = list_new(jitc_token_t);
+    smartptr(list(jitc_token_t)) if_empty = list_new(jitc_token_t);
+    uint64_t limit = UINT64_MAX;
+    jitc_token_t* token;
+    while ((token = advance(stream, curr_line))) {
+        jitc_token_t* param = token;
+        smartptr(list(jitc_token_t)) args = list_new(jitc_token_t);
+        expect_and(advance(stream, curr_line), this->type == TOKEN_PARENTHESIS_OPEN, "Expected '('");
+        int depth = 0;
+        while (true) {
+            token = expect(advance(stream, curr_line), "Expected ')'");
+            if (token->type == TOKEN_PARENTHESIS_OPEN) depth++;
+            if (token->type == TOKEN_PARENTHESIS_CLOSE && depth-- == 0) break;
+            list_add(args) = *token;
+        }
+        list(jitc_token_t)* target = NULL;
+        if (embed_param(param, "limit")) {
+            int64_t value;
+            try(compute_expression(context, macros, &(token_stream_t){(void*)args}, &value, 1));
+            if (value < 0) throw(param, "Negative embed limit");
+            limit = value;
+        }
+        else if (embed_param(param, "prefix")) target = (void*)prefix;
+        else if (embed_param(param, "suffix")) target = (void*)suffix;
+        else if (embed_param(param, "if_empty")) target = (void*)if_empty;
+        else throw(param, "Unknown embed parameter");
+        for (size_t i = 0; target && i < list_size(args); i++) list_add(target) = list_get(args, i);
+    }
+    if (!do_things) return true;
+    jitc_token_t blob = *file;
+    blob.type = TOKEN_EMBED;
+    blob.value.embed = try(jitc_embed(context, file, filename, limit));
+    bool empty = blob.value.embed->size == 0;
+    list(jitc_token_t)* tokens = empty ? (void*)if_empty : (void*)prefix;
+    for (size_t i = 0; i < list_size(tokens); i++) list_add(dest->tokens) = list_get(tokens, i);
+    if (empty) return true;
+    list_add(dest->tokens) = blob;
+    for (size_t i = 0; i < list_size(suffix); i++) list_add(dest->tokens) = list_get(suffix, i);
+    return true;
+}
+
+static const char* once_macro(jitc_context_t* context, const char* filename) {
+    smartptr(string_t) name = str_new();
+    str_appendf(name, "#pragma once %s", filename);
+    return jitc_append_string(context, str_data(name));
+}
+
+list_t* jitc_preprocess(jitc_context_t* context, list_t* _tokens, map_t* _macros, list_t* _dependencies) {
     typedef struct {
         jitc_token_t* start;
         enum {
@@ -459,15 +528,12 @@ queue_t* jitc_preprocess(jitc_context_t* context, queue_t* _token_queue, map_t*
 
     map(char*, macro_t)* macros = _macros;
     list(jitc_token_t)* dependencies = _dependencies;
-    queue(jitc_token_t)* token_queue = _token_queue;
+    list(jitc_token_t)* tokens = _tokens;
     smartptr(list(jitc_token_t)) result = list_new(jitc_token_t);
-    smartptr(list(jitc_token_t)) tokens = list_new(jitc_token_t);
     smartptr(stack(cond_t)) cond_stack = stack_new(cond_t);
+    smartptr(set(char*)) used_macros = hashset_new(hash_string, compare_string, char*);
     smartptr(map(char*, macro_t)) __macros = NULL;
-    if (!macros) macros = (void*)(__macros = map_new(compare_string, char*, macro_t));
-    while (queue_size(token_queue) > 0) list_add(tokens) = queue_pop(token_queue);
-    queue_delete(token_queue);
-    predefine(macros);
+    if (!macros) macros = (void*)(__macros = jitc_macro_table());
     token_stream_t stream = {(void*)tokens};
     token_stream_t out_stream = {(void*)result};
     int curr_line = 0;
@@ -479,7 +545,7 @@ queue_t* jitc_preprocess(jitc_context_t* context, queue_t* _token_queue, map_t*
             curr_line = token->row;
             token = optional(advance(&stream, &curr_line), continue);
             if (is_identifier(token, "define")) {
-                token = expect_and(advance(&stream, &curr_line), this->type == TOKEN_IDENTIFIER, "Expected identifier");
+                token = expect_and(advance(&stream, &curr_line), is_word(this), "Expected identifier");
                 macro_t* macro = do_things ? new_macro(macros, token->value.string, MacroType_Ordinary) : NULL;
                 jitc_token_t* paren = lookahead(&stream, curr_line);
                 if (paren && paren->type == TOKEN_PARENTHESIS_OPEN && paren->row == token->row && paren->col == token->col + strlen(token->value.string)) {
@@ -511,7 +577,7 @@ queue_t* jitc_preprocess(jitc_context_t* context, queue_t* _token_queue, map_t*
                 while ((token = advance(&stream, &curr_line))) if (macro) list_add(macro->tokens) = *token;
             }
             else if (is_identifier(token, "undef")) {
-                token = expect_and(advance(&stream, &curr_line), this->type == TOKEN_IDENTIFIER, "Expected identifier");
+                token = expect_and(advance(&stream, &curr_line), is_word(this), "Expected identifier");
                 if (do_things) {
                     map_find(macros, &token->value.string);
                     map_remove(macros);
@@ -522,34 +588,34 @@ queue_t* jitc_preprocess(jitc_context_t* context, queue_t* _token_queue, map_t*
                 if (do_things) throw(token, "%s", token->value.string);
             }
             else if (is_identifier(token, "include") || is_identifier(token, "embed")) {
+                bool embed = is_identifier(token, "embed");
                 token = expect_and(advance(&stream, &curr_line),
                     this->type == TOKEN_STRING ||
-                    this->type == TOKEN_IDENTIFIER,
+                    is_word(this),
                 "Expected string");
                 smartptr(list(jitc_token_t)) macro_stream_list = NULL;
                 token_stream_t macro_stream;
                 token_stream_t* curr_stream = &stream;
-                if (token->type == TOKEN_IDENTIFIER) {
+                if (is_word(token)) {
                     macro_stream_list = list_new(jitc_token_t);
                     macro_stream = (token_stream_t){(void*)macro_stream_list};
                     curr_stream = &macro_stream;
-                    smartptr(set(char*)) used_macros = set_new(compare_string, char*);
                     process_identifier(context, curr_stream, &stream, macros, used_macros, 0);
                     token = &list_get(curr_stream->tokens, curr_stream->ptr++);
                 }
                 char* filename = NULL;
                 if (token->type == TOKEN_STRING) filename = token->value.string;
                 else throw(token, "Expected string");
-                if (do_things) {
-                    queue(jitc_token_t)* included = try(jitc_include(context, token, filename, macros, dependencies));
-                    while (queue_size(included) > 1) {
-                        offsetof(jitc_variable_t, ptr);
-                        jitc_token_t* inc_token = &queue_pop(included);
-                        jitc_push_location(inc_token, token->filename, token->row, token->col);
+                if (embed) try(process_embed(context, &out_stream, &stream, &curr_line, token, filename, macros, do_things));
+                else if (do_things) {
+                    smartptr(list(jitc_token_t)) included = try(jitc_include(context, token, filename, macros, dependencies));
+                    // skip over EOF token
+                    for (size_t i = 0; i < list_size(included) - 1; i++) {
+                        jitc_token_t* inc_token = &list_get(included, i);
+                        jitc_push_location(context, inc_token, token->filename, token->row, token->col);
                         list_add(out_stream.tokens) = *inc_token;
                     }
                 }
-                // skip over EOF token
             }
             else if (is_identifier(token, "if")) {
                 smartptr(list(jitc_token_t)) list = list_new(jitc_token_t);
@@ -587,7 +653,7 @@ queue_t* jitc_preprocess(jitc_context_t* context, queue_t* _token_queue, map_t*
             }
             else if ((is_identifier(token, "ifdef") || is_identifier(token, "ifndef"))) {
                 bool negative = is_identifier(token, "ifndef");
-                token = expect_and(advance(&stream, &curr_line), this->type == TOKEN_IDENTIFIER, "Expected identifier");
+                token = expect_and(advance(&stream, &curr_line), is_word(this), "Expected identifier");
                 bool pass = !!map_find(macros, &token->value.string) ^ negative;
                 cond_t* cond = &stack_push(cond_stack);
                 cond->start = token;
@@ -597,13 +663,20 @@ queue_t* jitc_preprocess(jitc_context_t* context, queue_t* _token_queue, map_t*
             else if ((is_identifier(token, "elifdef")) || (is_identifier(token, "elifndef"))) {
                 if (stack_size(cond_stack) == 0) throw(token, "else without if");
                 bool negative = is_identifier(token, "ifndef");
-                token = expect_and(advance(&stream, &curr_line), this->type == TOKEN_IDENTIFIER, "Expected identifier");
+                token = expect_and(advance(&stream, &curr_line), is_word(this), "Expected identifier");
                 bool pass = !!map_find(macros, token->value.string) ^ negative;
                 cond_t* cond = &stack_peek(cond_stack);
                 if (cond->has_else) throw(token, "Duplicate else");
                 cond->start = token;
                 cond->state = cond->state != Cond_Expanded ? pass ? Cond_Expanding : Cond_WillExpand : Cond_Expanded;
             }
+            else if (is_identifier(token, "pragma")) {
+                token = advance(&stream, &curr_line);
+                if (do_things && token && is_identifier(token, "once")) {
+                    const char* name = once_macro(context, token->filename);
+                    if (!map_find(macros, &name)) new_macro(macros, name, MacroType_Ordinary);
+                }
+            }
             else if ((is_identifier(token, "depends"))) {
                 token = expect_and(advance(&stream, &curr_line), this->type == TOKEN_STRING, "Expected string literal");
                 if (do_things && dependencies) list_add(dependencies) = *token;
@@ -613,14 +686,15 @@ queue_t* jitc_preprocess(jitc_context_t* context, queue_t* _token_queue, map_t*
         }
         else if (do_things) {
             curr_line = token->row;
-            smartptr(set(char*)) used_macros = set_new(compare_string, char*);
-            if (token->type == TOKEN_IDENTIFIER) process_identifier(context, &out_stream, &stream, macros, used_macros, 0);
+            // used_macros is empty again after every top level expansion, so one set serves the whole file
+            if (is_word(token) && !token->disabled && map_find(macros, &token->value.string))
+                process_identifier(context, &out_stream, &stream, macros, used_macros, 0);
             else list_add(out_stream.tokens) = *token;
         }
         else curr_line = token->row;
     }
     if (stack_size(cond_stack) > 0) throw(stack_peek(cond_stack).start, "Unterminated condition");
-    queue(jitc_token_t)* queue = queue_new(jitc_token_t);
+    size_t size = 0;
     for (size_t i = 0; i < list_size(result); i++) {
         jitc_token_t* token = &list_get(result, i);
         if (token->type == TOKEN_STRING && list_get(result, i + 1).type == TOKEN_STRING) {
@@ -633,18 +707,124 @@ queue_t* jitc_preprocess(jitc_context_t* context, queue_t* _token_queue, map_t*
             i--;
             token = &string_token(jitc_append_string(context, str_data(str)));
             token->row = row; token->col = col; token->filename = filename;
-            queue_push(queue) = *token;
+            list_get(result, size++) = *token;
             str_delete(str);
             continue;
         }
-        for (int i = 0; i < num_token_table_entries && token->type == TOKEN_IDENTIFIER; i++) {
-            if (!token_table[i]) continue;
-            if (strcmp(token->value.string, token_table[i]) == 0) {
-                token->type = i;
-                break;
-            }
+        list_get(result, size++) = *token;
+    }
+    list_truncate(result, size);
+    return move(result);
+}
+
+static const char* guard_name(jitc_token_t* line, size_t length) {
+    if (length == 3 && is_identifier(&line[1], "ifndef") && is_word(&line[2])) return line[2].value.string;
+    if (length < 5 || !is_identifier(&line[1], "if") || line[2].type != TOKEN_EXCLAMATION_MARK || !is_identifier(&line[3], "defined")) return NULL;
+    if (length == 5 && is_word(&line[4])) return line[4].value.string;
+    if (length == 7 && line[4].type == TOKEN_PARENTHESIS_OPEN && is_word(&line[5]) && line[6].type == TOKEN_PARENTHESIS_CLOSE) return line[5].value.string;
+    return NULL;
+}
+
+const char* jitc_include_guard(jitc_context_t* context, list_t* _tokens) {
+    list(jitc_token_t)* tokens = _tokens;
+    const char* guard = NULL;
+    bool guarded = true;
+    int depth = 0;
+    size_t start = 0;
+    while (list_get(tokens, start).type != TOKEN_END_OF_FILE) {
+        jitc_token_t* line = &list_get(tokens, start);
+        size_t length = 1;
+        while (line[length].type != TOKEN_END_OF_FILE && (line[length].row == line[length - 1].row || line[length - 1].type == TOKEN_BACKSLASH)) length++;
+        start += length;
+        if (line->type != TOKEN_HASHTAG) {
+            if (depth == 0) guarded = false;
+            continue;
+        }
+        if (length == 1) continue;
+        if (depth == 0 && length == 3 && is_identifier(&line[1], "pragma") && is_identifier(&line[2], "once"))
+            return once_macro(context, line->filename);
+        if (is_identifier(&line[1], "if") || is_identifier(&line[1], "ifdef") || is_identifier(&line[1], "ifndef")) {
+            if (depth++ > 0) continue;
+            if (guard || line != &list_get(tokens, 0)) guarded = false;
+            else if (!(guard = guard_name(line, length))) guarded = false;
         }
-        queue_push(queue) = *token;
+        else if (is_identifier(&line[1], "endif")) {
+            if (--depth < 0) guarded = false;
+        }
+        else if (depth == 0) guarded = false;
+        else if (depth == 1 && (
+            is_identifier(&line[1], "else") || is_identifier(&line[1], "elif") ||
+            is_identifier(&line[1], "elifdef") || is_identifier(&line[1], "elifndef")
+        )) guarded = false;
     }
-    return queue;
+    return guarded && depth == 0 ? guard : NULL;
+}
+
+map_t* jitc_macro_table() {
+    map_t* macros = hashmap_new(hash_string, compare_string, char*, macro_t);
+    predefine(macros);
+    return macros;
+}
+
+void jitc_delete_macro_table(map_t* _macros) {
+    map(char*, macro_t)* macros = _macros;
+    for (size_t i = 0; i < map_size(macros); i++) {
+        map_index(macros, i);
+        macro_t* macro = &map_get_value(macros);
+        if (macro->type == MacroType_Ordinary || macro->type == MacroType_OrdinaryFunction) list_delete(macro->tokens);
+        if (macro->type == MacroType_OrdinaryFunction) list_delete(macro->args);
+    }
+    map_delete(macros);
+}
+
+uint64_t jitc_hash_predefined() {
+    static uint64_t hash = 0;
+    if (hash) return hash;
+    smartptr(map(char*, macro_t)) macros = jitc_macro_table();
+    hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < map_size(macros); i++) {
+        map_index(macros, i);
+        macro_t* macro = &map_get_value(macros);
+        hash = (hash ^ hash_string(&map_get_key(macros))) * 0x100000001b3;
+        hash = (hash ^ macro->type) * 0x100000001b3;
+        if (macro->type != MacroType_Ordinary) continue;
+        for (size_t j = 0; j < list_size(macro->tokens); j++) {
+            jitc_token_t* token = &list_get(macro->tokens, j);
+            hash = (hash ^ token->type) * 0x100000001b3;
+            if (is_word(token) || token->type == TOKEN_STRING) hash = (hash ^ hash_string(&token->value.string)) * 0x100000001b3;
+            else hash = (hash ^ token->value.integer) * 0x100000001b3;
+        }
+        list_delete(macro->tokens);
+    }
+    return hash;
+}
+
+void jitc_collect_words(set_t* _words, list_t* _tokens) {
+    set(char*)* words = _words;
+    list(jitc_token_t)* tokens = _tokens;
+    for (size_t i = 0; i < list_size(tokens); i++) {
+        jitc_token_t* token = &list_get(tokens, i);
+        if (!is_word(token) || set_find(words, &token->value.string)) continue;
+        set_add(words) = token->value.string;
+        set_commit(words);
+    }
+}
+
+bool jitc_import_macros(map_t* _macros, map_t* _snapshot, set_t* _words) {
+    map(char*, macro_t)* macros = _macros;
+    map(char*, macro_t)* snapshot = _snapshot;
+    set(char*)* words = _words;
+    // a macro the prelude didn't see could change how its headers expand
+    for (size_t i = 0; i < map_size(macros); i++) {
+        map_index(macros, i);
+        char* name = map_get_key(macros);
+        if (set_find(words, &name) && !map_find(snapshot, &name)) return false;
+    }
+    for (size_t i = 0; i < map_size(snapshot); i++) {
+        map_index(snapshot, i);
+        map_add(macros) = map_get_key(snapshot);
+        map_commit(macros);
+        map_get_value(macros) = map_get_value(snapshot);
+    }
+    return true;
 }
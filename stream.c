@@ -0,0 +1,167 @@
+#include "cleanups.h"
+#include "dynamics.h"
+#include "jitc.h"
+#include "jitc_internal.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct jitc_stream_t {
+    jitc_context_t* context;
+    const char* filename;
+    string_t* buffer;
+    map_t* macros;
+    size_t scanned;
+    size_t cut;
+    int row;
+    bool failed;
+    enum {
+        Scan_Code,
+        Scan_String,
+        Scan_Char,
+        Scan_LineComment,
+        Scan_BlockComment,
+    } mode;
+    char prev, last;
+    char word[8];
+    size_t word_length;
+    int depth, conds;
+    bool slash, escape;
+    bool line_start;
+    bool directive, word_done;
+    bool initializer, function;
+    bool complete, directive_complete;
+};
+
+jitc_stream_t* jitc_stream_begin(jitc_context_t* context, const char* filename) {
+    jitc_stream_t* stream = calloc(1, sizeof(jitc_stream_t));
+    stream->context = context;
+    stream->filename = jitc_append_string(context, filename);
+    stream->buffer = str_new();
+    stream->macros = jitc_macro_table();
+    jitc_vfs_reset(context->vfs);
+    stream->row = 1;
+    stream->line_start = true;
+    stream->complete = true;
+    return stream;
+}
+
+static void jitc_stream_directive(jitc_stream_t* stream) {
+    stream->word[stream->word_length] = 0;
+    if (strcmp(stream->word, "if") == 0 || strcmp(stream->word, "ifdef") == 0 || strcmp(stream->word, "ifndef") == 0) stream->conds++;
+    if (strcmp(stream->word, "endif") == 0 && stream->conds > 0) stream->conds--;
+    stream->directive = false;
+    stream->complete = stream->directive_complete;
+}
+
+static void jitc_stream_token(jitc_stream_t* stream, char c) {
+    if (stream->line_start && c == '#') {
+        stream->line_start = false;
+        stream->directive = true;
+        stream->directive_complete = stream->complete;
+        stream->word_length = 0;
+        stream->word_done = false;
+        return;
+    }
+    stream->line_start = false;
+    if (c == '"') stream->mode = Scan_String;
+    if (c == '\'') stream->mode = Scan_Char;
+    if (stream->directive) {
+        if (!stream->word_done && isalpha((unsigned char)c) && stream->word_length < sizeof(stream->word) - 1)
+            stream->word[stream->word_length++] = c;
+        else stream->word_done = true;
+        return;
+    }
+    bool complete = false;
+    if (c == '=' && stream->depth == 0) stream->initializer = true;
+    if (c == '{' && stream->depth == 0) stream->function = stream->last == ')' && !stream->initializer;
+    if (c == '(' || c == '[' || c == '{') stream->depth++;
+    if ((c == ')' || c == ']' || c == '}') && stream->depth > 0) {
+        stream->depth--;
+        complete = c == '}' && stream->depth == 0 && stream->function;
+    }
+    if (c == ';' && stream->depth == 0) complete = true;
+    if (complete) stream->initializer = false;
+    stream->complete = complete;
+    stream->last = c;
+}
+
+// only tracks enough of the lexical structure to find where top-level declarations end,
+// cuts are made at line ends so that directives still start their own line
+static void jitc_stream_scan(jitc_stream_t* stream, char c, size_t offset) {
+    char prev = stream->prev;
+    stream->prev = c;
+    if (c == '\n') {
+        if (prev == '\\' || stream->mode == Scan_BlockComment) return;
+        if (stream->slash) jitc_stream_token(stream, '/');
+        stream->slash = stream->escape = false;
+        stream->mode = Scan_Code;
+        if (stream->directive) jitc_stream_directive(stream);
+        stream->line_start = true;
+        if (stream->complete && stream->depth == 0 && stream->conds == 0) stream->cut = offset + 1;
+        return;
+    }
+    switch (stream->mode) {
+        case Scan_Code: break;
+        case Scan_LineComment: return;
+        case Scan_BlockComment:
+            if (prev == '*' && c == '/') {
+                stream->mode = Scan_Code;
+                stream->prev = ' ';
+            }
+            return;
+        case Scan_String:
+        case Scan_Char:
+            if (stream->escape) stream->escape = false;
+            else if (c == '\\') stream->escape = true;
+            else if (c == (stream->mode == Scan_String ? '"' : '\'')) stream->mode = Scan_Code;
+            return;
+    }
+    if (stream->slash) {
+        stream->slash = false;
+        if (c == '/' || c == '*') {
+            stream->mode = c == '/' ? Scan_LineComment : Scan_BlockComment;
+            stream->prev = ' ';
+            return;
+        }
+        jitc_stream_token(stream, '/');
+    }
+    if (c == '/') stream->slash = true;
+    else if (!isspace((unsigned char)c)) jitc_stream_token(stream, c);
+    else if (stream->directive && stream->word_length > 0) stream->word_done = true;
+}
+
+static bool jitc_stream_compile(jitc_stream_t* stream, const char* code, size_t length) {
+    jitc_context_t* context = stream->context;
+    smartptr(list(jitc_token_t)) lexed = try(jitc_lex_from(context, code, length, stream->filename, stream->row));
+    smartptr(list(jitc_token_t)) tokens = try(jitc_preprocess(context, lexed, stream->macros, NULL));
+    return jitc_parse_tokens(context, tokens);
+}
+
+bool jitc_stream_feed(jitc_stream_t* stream, const char* data, size_t length) {
+    if (stream->failed) return false;
+    str_append_n(stream->buffer, data, length);
+    const char* buffer = str_data(stream->buffer);
+    for (; stream->scanned < str_length(stream->buffer); stream->scanned++)
+        jitc_stream_scan(stream, buffer[stream->scanned], stream->scanned);
+    if (stream->cut == 0) return true;
+    size_t cut = stream->cut;
+    stream->failed = !jitc_stream_compile(stream, buffer, cut);
+    for (const char* ptr = buffer; (ptr = memchr(ptr, '\n', buffer + cut - ptr)); ptr++) stream->row++;
+    string_t* rest = str_new();
+    str_append_n(rest, buffer + cut, str_length(stream->buffer) - cut);
+    str_delete(stream->buffer);
+    stream->buffer = rest;
+    stream->scanned -= cut;
+    stream->cut = 0;
+    return !stream->failed;
+}
+
+bool jitc_stream_end(jitc_stream_t* stream) {
+    bool success = !stream->failed && jitc_stream_compile(stream, str_data(stream->buffer), str_length(stream->buffer));
+    str_delete(stream->buffer);
+    map_delete(stream->macros);
+    free(stream);
+    return success;
+}
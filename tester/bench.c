@@ -0,0 +1,69 @@
+#include "../jitc_internal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char* snippets[] = {
+    "    int some_identifier_%d = %d + 0x%x;\n",
+    "    // line comment number %d with some text in it, %d\n",
+    "    /* block comment %d\n       spanning multiple lines %d */\n",
+    "    const char* string_%d = \"a fairly long string literal with \\\"escapes\\\" %d\\n\";\n",
+    "    if (variable_%d >= %d) return structure.field_name->other_field;\n",
+    "    double floating_%d = %d.25e3;\n",
+};
+
+static char* generate_source(size_t size) {
+    string_t* str = str_new();
+    str_append(str, "int main() {\n");
+    for (int i = 0; str_length(str) < size; i++)
+        str_appendf(str, snippets[i % (sizeof(snippets) / sizeof(*snippets))], i, i * 7, i * 13);
+    str_append(str, "}\n");
+    char* source = strdup(str_data(str));
+    str_delete(str);
+    return source;
+}
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv) {
+    size_t size = (argc > 1 ? atoi(argv[1]) : 8) * 1024 * 1024;
+    int iterations = argc > 2 ? atoi(argv[2]) : 10;
+    char* source = generate_source(size);
+    jitc_context_t* context = jitc_create_context();
+    double best = 0;
+    uint64_t checksum = 0;
+    size_t num_tokens = 0;
+    for (int i = 0; i < iterations; i++) {
+        double start = now();
+        list(jitc_token_t)* tokens = jitc_lex(context, source, strlen(source), "bench.c");
+        double elapsed = now() - start;
+        if (!tokens) {
+            jitc_report_error(context, stdout);
+            return 1;
+        }
+        if (i == 0 || elapsed < best) best = elapsed;
+        checksum = 0;
+        num_tokens = list_size(tokens);
+        for (size_t j = 0; j < list_size(tokens); j++) {
+            jitc_token_t* token = &list_get(tokens, j);
+            checksum = checksum * 31 + token->type;
+            checksum = checksum * 31 + token->row * 65536 + token->col;
+            if (token->type == TOKEN_STRING || token->type == TOKEN_IDENTIFIER) checksum = checksum * 31 + interner_id(token->value.string);
+            if (token->type == TOKEN_INTEGER || token->type == TOKEN_FLOAT) checksum = checksum * 31 + token->value.integer;
+        }
+        list_delete(tokens);
+    }
+    printf("%s: %.2f MiB, %zu tokens, best of %d: %.3f ms (%.1f MiB/s), checksum %016lx\n",
+        getenv("JITC_SCALAR_LEXER") ? "scalar" : "simd",
+        strlen(source) / 1048576.0, num_tokens, iterations, best * 1000, strlen(source) / 1048576.0 / best, checksum
+    );
+    jitc_destroy_context(context);
+    free(source);
+    return 0;
+}
@@ -1,11 +1,10 @@
 #include "../jitc_internal.h"
 
-queue_t* print_tokens(const char* source, queue_t* _tokens) {
+void print_tokens(const char* source, list_t* _tokens) {
     printf("-- %s --\n", source);
-    queue(jitc_token_t)* tokens = _tokens;
-    queue(jitc_token_t)* out = queue_new(jitc_token_t);
-    while (queue_size(tokens) > 0) {
-        jitc_token_t* token = &queue_peek(tokens);
+    list(jitc_token_t)* tokens = _tokens;
+    for (size_t i = 0; i < list_size(tokens); i++) {
+        jitc_token_t* token = &list_get(tokens, i);
         printf("(%s %d:%d) ", token->filename, token->row, token->col);
         switch (token->type) {
             case TOKEN_END_OF_FILE: printf("eof\n"); break;
@@ -13,11 +12,10 @@ queue_t* print_tokens(const char* source, queue_t* _tokens) {
             case TOKEN_INTEGER: printf("int (%ld)\n", token->value.integer); break;
             case TOKEN_FLOAT: printf("float (%f)\n", token->value.floating); break;
             case TOKEN_STRING: printf("str (%s)\n", token->value.string); break;
+            case TOKEN_EMBED: printf("embed (%zu bytes)\n", interner_length(token->value.string)); break;
             default: printf("%s\n", token_table[token->type]);
         }
-        queue_push(out) = queue_pop(tokens);
     }
-    return out;
 }
 
 void print_type(jitc_type_t* type, int indent) {
@@ -150,6 +148,9 @@ void print_ast(jitc_ast_t* ast, int indent) {
         case AST_Break:
         case AST_Continue: break;
         case AST_Initializer: break;
+        case AST_Blob:
+            printf(": %zu bytes\n", ast->blob.size);
+            break;
     }
 }
 
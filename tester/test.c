@@ -4,6 +4,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
 
 struct {
     const char* name;
@@ -20,11 +23,25 @@ static int sort_string(const void* a, const void* b) {
     return strcmp(*(char**)a, *(char**)b);
 }
 
+static bool stream_mode = false;
+
+// feeds the file one byte at a time, so every possible chunk boundary gets crossed
+static bool stream_file(jitc_context_t* context, const char* name) {
+    FILE* file = fopen(name, "r");
+    if (!file) return jitc_parse_file(context, name);
+    jitc_stream_t* stream = jitc_stream_begin(context, name);
+    bool success = true;
+    int c;
+    while (success && (c = fgetc(file)) != EOF) success = jitc_stream_feed(stream, &(char){c}, 1);
+    fclose(file);
+    return jitc_stream_end(stream) && success;
+}
+
 static bool run_test(const char* name) {
     printf("Running test %s ... ", name);
     int(*main_func)();
     jitc_context_t* context = jitc_create_context();
-    if (!jitc_parse_file(context, name) || !(main_func = jitc_get(context, "main"))) {
+    if (!(stream_mode ? stream_file(context, name) : jitc_parse_file(context, name)) || !(main_func = jitc_get(context, "main"))) {
         printf("FAILED (compile error): ");
         jitc_report_error(context, stdout);
         jitc_destroy_context(context);
@@ -37,6 +54,175 @@ static bool run_test(const char* name) {
     return result == 0;
 }
 
+static const char* built_file;
+
+static void build_callback(const char* curr_file, int num_files_total, int num_files_compiled) {
+    if (curr_file) built_file = curr_file;
+}
+
+static bool run_build_test(const char* name) {
+    printf("Running build of %s ... ", name);
+    built_file = NULL;
+    jitc_context_t* context = jitc_create_context();
+    bool success = jitc_append_task_file(context, name) && jitc_build(context, build_callback);
+    if (!success) {
+        printf("FAILED (compile error): ");
+        jitc_report_error(context, stdout);
+    }
+    else if (!built_file || strcmp(built_file, name) != 0) {
+        printf("FAILED (reported as %s)\n", built_file ? built_file : "nothing");
+        success = false;
+    }
+    else printf("PASSED\n");
+    jitc_destroy_context(context);
+    return success;
+}
+
+static int call_inc(jitc_context_t* context) {
+    int(*inc)() = jitc_get(context, "inc");
+    return inc ? inc() : -1;
+}
+
+static bool run_clone_test(const char* name) {
+    printf("Running clones of %s ... ", name);
+    jitc_context_t* source = jitc_create_context();
+    if (!jitc_parse_file(source, name)) {
+        printf("FAILED (compile error): ");
+        jitc_report_error(source, stdout);
+        jitc_destroy_context(source);
+        return false;
+    }
+    call_inc(source);
+    jitc_context_t* a = jitc_clone_context(source);
+    jitc_context_t* b = jitc_clone_context(source);
+    call_inc(a);
+    jitc_context_t* c = jitc_clone_context(a);
+    int results[] = { call_inc(a), call_inc(b), call_inc(source), call_inc(c) };
+    int expected[] = { 3, 2, 2, 3 };
+    jitc_destroy_context(source);
+    jitc_destroy_context(a);
+    jitc_destroy_context(b);
+    jitc_destroy_context(c);
+    for (int i = 0; i < sizeof(results) / sizeof(*results); i++) {
+        if (results[i] == expected[i]) continue;
+        printf("FAILED (context %d counted %d, expected %d)\n", i, results[i], expected[i]);
+        return false;
+    }
+    printf("PASSED\n");
+    return true;
+}
+
+// every blank line separated part goes through its own parse, so templates get reused across parses
+static bool run_split_test(const char* name) {
+    printf("Running split parses of %s ... ", name);
+    FILE* file = fopen(name, "r");
+    if (!file) {
+        printf("FAILED (unable to open)\n");
+        return false;
+    }
+    char source[4096];
+    source[fread(source, 1, sizeof(source) - 1, file)] = 0;
+    fclose(file);
+    int(*main_func)();
+    jitc_context_t* context = jitc_create_context();
+    bool success = true;
+    for (char* part = source; success && part;) {
+        char* next = strstr(part, "\n\n");
+        if (next) *next = 0;
+        success = jitc_parse(context, part, name);
+        part = next ? next + 2 : NULL;
+    }
+    if (!success || !(main_func = jitc_get(context, "main"))) {
+        printf("FAILED (compile error): ");
+        jitc_report_error(context, stdout);
+        jitc_destroy_context(context);
+        return false;
+    }
+    int result = main_func();
+    jitc_destroy_context(context);
+    if (result != 0) printf("FAILED (returned %d)\n", result);
+    else printf("PASSED\n");
+    return result == 0;
+}
+
+static void write_file(const char* path, const char* content) {
+    FILE* file = fopen(path, "w");
+    fputs(content, file);
+    fclose(file);
+}
+
+static bool find_cache_file(const char* dir, char* path) {
+    DIR* handle = opendir(dir);
+    struct dirent* dirent;
+    bool found = false;
+    while (!found && (dirent = readdir(handle))) {
+        if (!strstr(dirent->d_name, ".jtc")) continue;
+        snprintf(path, PATH_MAX, "%s/%s", dir, dirent->d_name);
+        found = true;
+    }
+    closedir(handle);
+    return found;
+}
+
+static int run_cached(const char* cache_dir, const char* first_dir, const char* second_dir) {
+    const char* code = "#include \"cached.h\"\nint main() { return VALUE; }\n";
+    jitc_context_t* context = jitc_create_context();
+    jitc_set_cache_dir(context, cache_dir);
+    jitc_add_include_dir(context, first_dir);
+    jitc_add_include_dir(context, second_dir);
+    int(*main_func)();
+    int result = jitc_parse(context, code, "cached.c") && (main_func = jitc_get(context, "main")) ? main_func() : -1;
+    jitc_destroy_context(context);
+    return result;
+}
+
+static bool run_cache_test() {
+    printf("Running token cache ... ");
+    char root[] = "/tmp/jitc-cache-XXXXXX";
+    if (!mkdtemp(root)) {
+        printf("FAILED (no temporary directory)\n");
+        return false;
+    }
+    char cache_dir[PATH_MAX], first_dir[PATH_MAX], second_dir[PATH_MAX], first_header[PATH_MAX], second_header[PATH_MAX], cache_file[PATH_MAX];
+    snprintf(cache_dir, PATH_MAX, "%s/cache", root);
+    snprintf(first_dir, PATH_MAX, "%s/first", root);
+    snprintf(second_dir, PATH_MAX, "%s/second", root);
+    snprintf(first_header, PATH_MAX, "%s/cached.h", first_dir);
+    snprintf(second_header, PATH_MAX, "%s/cached.h", second_dir);
+    mkdir(cache_dir, 0755);
+    mkdir(first_dir, 0755);
+    mkdir(second_dir, 0755);
+    const char* failure = NULL;
+    write_file(second_header, "#define VALUE 1\n");
+    if (run_cached(cache_dir, first_dir, second_dir) != 1) failure = "cold parse";
+    else if (!find_cache_file(cache_dir, cache_file)) failure = "cold parse wasn't stored";
+    else {
+        // a hit reads the entry without rewriting it
+        utime(cache_file, &(struct utimbuf){ 0, 0 });
+        struct stat info;
+        if (run_cached(cache_dir, first_dir, second_dir) != 1) failure = "warm parse";
+        else if (stat(cache_file, &info) != 0 || info.st_mtime != 0) failure = "warm parse missed the cache";
+        else {
+            write_file(second_header, "#define VALUE 2 // edited\n");
+            if (run_cached(cache_dir, first_dir, second_dir) != 2) failure = "edited header";
+            else {
+                write_file(first_header, "#define VALUE 3\n");
+                if (run_cached(cache_dir, first_dir, second_dir) != 3) failure = "header earlier in the search path";
+            }
+        }
+    }
+    while (find_cache_file(cache_dir, cache_file)) remove(cache_file);
+    remove(first_header);
+    remove(second_header);
+    rmdir(cache_dir);
+    rmdir(first_dir);
+    rmdir(second_dir);
+    rmdir(root);
+    if (failure) printf("FAILED (%s)\n", failure);
+    else printf("PASSED\n");
+    return !failure;
+}
+
 static void test_directory(const char* dirname, int* total, int* ran, int* failed) {
     int count = 0;
     DIR* dir = opendir(dirname);
@@ -78,8 +264,27 @@ static void test_directory(const char* dirname, int* total, int* ran, int* faile
 
 int main(int argc, char** argv) {
     int total = 0, ran = 0, failed = 0;
-    if (argc == 1)
+    if (argc > 1 && strcmp(argv[1], "--stream") == 0) {
+        stream_mode = true;
+        argv[1] = argv[0];
+        argc--;
+        argv++;
+    }
+    if (argc == 1) {
         test_directory("tests/", &total, &ran, &failed);
+        // the progress callback names the task file even when its first tokens come from a nested include
+        total++; ran++;
+        if (!run_build_test("tests/preprocessor/021-nested-include.c")) failed++;
+        // clones get private copies of the source's globals at the fork
+        total++; ran++;
+        if (!run_clone_test("tests/variables/012-clone.c")) failed++;
+        // template instances created in one parse are called from functions of the next
+        total++; ran++;
+        if (!run_split_test("tests/templates/009-reuse.c")) failed++;
+        // cold, warm, edited and shadowed headers through the token cache
+        total++; ran++;
+        if (!run_cache_test()) failed++;
+    }
     else for (int i = 1; i < argc; i++) {
         total++; ran++;
         if (!run_test(argv[i])) failed++;
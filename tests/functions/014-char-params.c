@@ -0,0 +1,13 @@
+char sum(char a, char b, char c, char d) {
+    return a + b + c + d;
+}
+
+int widen(char a) {
+    return a;
+}
+
+int main() {
+    if (sum(1, 2, 3, 4) != 10) return 1;
+    if (widen(-5) != -5) return 2;
+    return 0;
+}
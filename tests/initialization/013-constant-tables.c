@@ -0,0 +1,24 @@
+struct point {
+    int x;
+    float y;
+    char tag;
+    int id;
+};
+
+int table[256] = { 1, 2, 3, [200] = 4, 5 };
+struct point points[] = { { 1, 1.5f, 'a', 10 }, { 2, 2.5f, 'b', 20 }, [4] = { 5, -0.25f, 'e', 50 } };
+double weights[] = { 0.5, 1.25, -3.0 };
+
+int main() {
+    int local[8] = { 9, 8, 7, 6, 5, 4, 3, 2 };
+    struct point p = { 3, 0.75f, 'c', 30 };
+    int n = 11;
+    int mixed[4] = { 1, n, 3 };
+    if (table[0] != 1 || table[2] != 3 || table[199] != 0 || table[200] != 4 || table[201] != 5 || table[255] != 0) return 1;
+    if (sizeof(points) != 5 * sizeof(struct point) || points[1].y != 2.5f || points[4].tag != 'e' || points[4].id != 50 || points[3].x != 0) return 2;
+    if (weights[1] != 1.25 || weights[2] != -3.0) return 3;
+    if (local[0] != 9 || local[7] != 2) return 4;
+    if (p.x != 3 || p.y != 0.75f || p.tag != 'c' || p.id != 30) return 5;
+    if (mixed[1] != 11 || mixed[2] != 3 || mixed[3] != 0) return 6;
+    return 0;
+}
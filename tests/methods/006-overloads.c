@@ -0,0 +1,19 @@
+struct A { int x; };
+struct B { int x; };
+
+int get(int* this) -> *this;
+int get(struct A* this) -> this.x + 10;
+int get(struct B* this) -> this.x + 20;
+int get(const int* this) -> *this + 30;
+
+int main() {
+    int i = 1;
+    const int c = 2;
+    struct A a = { 3 };
+    struct B b = { 4 };
+    if (i.get() != 1) return 1;
+    if (c.get() != 32) return 2;
+    if (a.get() != 13) return 3;
+    if (b.get() != 24) return 4;
+    return 0;
+}
\ No newline at end of file
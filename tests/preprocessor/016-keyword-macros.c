@@ -0,0 +1,13 @@
+#define inline
+#define ADD(int, char) int + char
+
+#ifndef inline
+#define X 1
+#elif !defined(static) && defined bool
+#define X 0
+#endif
+
+inline int main() {
+    if (ADD(1, 2) != 3) return 1;
+    return X;
+}
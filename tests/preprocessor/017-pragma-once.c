@@ -0,0 +1,8 @@
+#pragma once
+#include "tests/preprocessor/017-pragma-once.c"
+#include "stdlib.h"
+#include "stdlib.h"
+
+int main() {
+    return 0;
+}
@@ -0,0 +1,18 @@
+#include "stdio.h"
+#include "math.h"
+
+#define size_t int
+#include "stdlib.h"
+#undef size_t
+
+int abs(int) {
+    return 42;
+}
+
+int main() {
+    if (sizeof(size_t) != 8) return 1;
+    if (abs(-1) != 42) return 2;
+    if (floor(2.5) != 2.0) return 3;
+    if (EOF != -1) return 4;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,35 @@
+unsigned char self[] = {
+#embed __FILE__
+};
+
+char first[] = {
+#embed __FILE__ limit(8) suffix(, 0)
+};
+
+int wide[] = {
+#embed __FILE__ limit(2)
+};
+
+int empty[] = {
+#embed "tests/preprocessor/019-embed.c" limit(0) prefix(1,) if_empty(-1)
+};
+
+struct {
+    char tag[3];
+    int value;
+} tagged = { {
+#embed __FILE__ limit(3)
+}, 42 };
+
+int main() {
+    char local[] = {
+#embed __FILE__ __limit__(5)
+    };
+    if (sizeof(self) < 500 || self[0] != 'u' || self[sizeof(self) - 1] != '\n') return 1;
+    if (sizeof(first) != 9 || first[7] != 'd' || first[8] != 0) return 2;
+    if (wide[0] != 'u' || wide[1] != 'n') return 3;
+    if (sizeof(empty) != sizeof(int) || empty[0] != -1) return 4;
+    if (tagged.tag[2] != 's' || tagged.value != 42) return 5;
+    if (sizeof(local) != 5 || local[4] != 'g') return 6;
+    return 0;
+}
@@ -0,0 +1,10 @@
+#ifndef INCLUDED
+#define INCLUDED
+#include "020-relative-include.c"
+
+int main() {
+    return VALUE - 42;
+}
+#else
+#define VALUE 42
+#endif
@@ -0,0 +1,15 @@
+#ifndef OUTER
+#define OUTER
+#include "tests/../tests/preprocessor/021-nested-include.c"
+
+int main() {
+    return value() - 42;
+}
+#elif !defined(INNER)
+#define INNER
+#include "./tests/preprocessor/021-nested-include.c"
+#else
+int value() {
+    return 42;
+}
+#endif
\ No newline at end of file
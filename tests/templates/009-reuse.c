@@ -0,0 +1,19 @@
+<T> T twice(T a) -> a + a;
+
+typedef int number;
+
+int first() -> twice<int>(1);
+int second() -> twice<int>(2) + twice<number>(3);
+
+char third() -> twice<char>(3) + twice<char>(-9) + twice<char>(7);
+
+int main() {
+    if (first() + second() != 12) return 1;
+    if (third() != 2) return 7;
+    if (twice<float>(1.5f) != 3.0f) return 2;
+    if (twice<char>(100) != -56) return 3;
+    if (twice<unsigned char>(100) != 200) return 4;
+    if (twice<long>(0x40000000) != 0x80000000) return 5;
+    if (twice<int> != twice<int>) return 6;
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+struct pair { int a, b; };
+int x = 1;
+
+int main() {
+    if (x != 1) return 1;
+    int x = 2;
+    {
+        if (x != 2) return 2;
+        long x = 3;
+        struct pair { long a, b; };
+        {
+            int x = 4;
+            if (x != 4) return 3;
+            if (sizeof(struct pair) != 16) return 4;
+        }
+        if (x != 3 || sizeof(x) != 8) return 5;
+    }
+    if (x != 2) return 6;
+    if (sizeof(struct pair) != 8 || sizeof((struct pair){}.b) != 4) return 7;
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+int counter;
+
+int inc() {
+    return ++counter;
+}
+
+int main() {
+    return inc() + inc() - 3;
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "cleanups.h"
+#include "dynamics.h"
+#include "jitc.h"
+#include "jitc_internal.h"
+
+#include "compares.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+jitc_vfs_t* jitc_vfs_new() {
+    jitc_vfs_t* vfs = malloc(sizeof(jitc_vfs_t));
+    vfs->include_dirs = list_new(char*);
+    vfs->callback = NULL;
+    vfs->userdata = NULL;
+    vfs->files = hashmap_new(hash_string, compare_string, char*, jitc_vfs_file_t*);
+    vfs->resolved = hashmap_new(hash_string, compare_string, char*, char*);
+    return vfs;
+}
+
+// files may change between parses of a live context, so nothing read from disk outlives one
+void jitc_vfs_reset(jitc_vfs_t* vfs) {
+    for (size_t i = 0; i < map_size(vfs->files); i++) {
+        map_index(vfs->files, i);
+        jitc_vfs_file_t* file = map_get_value(vfs->files);
+        if (!file) continue;
+        jitc_unload_file(&file->source);
+        free(file);
+    }
+    map_clear(vfs->files);
+    map_clear(vfs->resolved);
+}
+
+void jitc_vfs_delete(jitc_vfs_t* vfs) {
+    jitc_vfs_reset(vfs);
+    list_delete(vfs->include_dirs);
+    map_delete(vfs->files);
+    map_delete(vfs->resolved);
+    free(vfs);
+}
+
+void jitc_add_include_dir(jitc_context_t* context, const char* path) {
+    size_t length = strlen(path);
+    while (length > 1 && path[length - 1] == '/') length--;
+    list_add(context->vfs->include_dirs) = jitc_append_string_n(context, path, length);
+    map_clear(context->vfs->resolved);
+}
+
+void jitc_set_file_callback(jitc_context_t* context, jitc_file_callback_t callback, void* userdata) {
+    context->vfs->callback = callback;
+    context->vfs->userdata = userdata;
+    map_clear(context->vfs->resolved);
+}
+
+// one stat per candidate, the result is cached with the file for the rest of the parse
+static bool jitc_vfs_exists(const char* path) {
+#ifndef _WIN32
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISREG(info.st_mode);
+#else
+    return true;
+#endif
+}
+
+jitc_vfs_file_t* jitc_vfs_lookup(jitc_context_t* context, const char* path) {
+    jitc_vfs_t* vfs = context->vfs;
+    path = jitc_append_string(context, path);
+    if (map_find(vfs->files, &path)) return map_get_value(vfs->files);
+    jitc_vfs_file_t* file = NULL;
+    size_t length = 0;
+    const char* content = vfs->callback ? vfs->callback(vfs->userdata, path, &length) : NULL;
+    if (content) {
+        file = malloc(sizeof(jitc_vfs_file_t));
+        file->source = (jitc_source_file_t){ memcpy(malloc(length + 1), content, length), length, false };
+        file->source.data[length] = 0;
+    }
+    else if (jitc_vfs_exists(path)) {
+        jitc_source_file_t source;
+        if (jitc_load_file(context, path, &source)) {
+            file = malloc(sizeof(jitc_vfs_file_t));
+            file->source = source;
+        }
+        else jitc_destroy_error(jitc_get_error(context));
+    }
+    if (file) {
+        file->path = path;
+        file->hash = hash_bytes(file->source.data, file->source.size);
+    }
+    map_add(vfs->files) = (char*)path;
+    map_commit(vfs->files);
+    map_get_value(vfs->files) = file;
+    return file;
+}
+
+static const char* jitc_vfs_join(jitc_context_t* context, const char* dir, size_t dir_length, const char* name) {
+    if (dir_length == 0) return jitc_append_string(context, name);
+    smartptr(string_t) path = str_new();
+    str_appendf(path, "%.*s%s%s", (int)dir_length, dir, dir[dir_length - 1] == '/' ? "" : "/", name);
+    return jitc_append_string(context, str_data(path));
+}
+
+jitc_vfs_file_t* jitc_vfs_find(jitc_context_t* context, const char* includer, const char* name) {
+    jitc_vfs_t* vfs = context->vfs;
+    const char* slash = includer ? strrchr(includer, '/') : NULL;
+    size_t dir_length = slash ? slash - includer + (slash == includer) : 0;
+    smartptr(string_t) key_str = str_new();
+    str_appendf(key_str, "%.*s\x01%s", (int)dir_length, includer ? includer : "", name);
+    const char* key = jitc_append_string(context, str_data(key_str));
+    if (!context->recording && map_find(vfs->resolved, &key)) {
+        const char* path = map_get_value(vfs->resolved);
+        return path ? jitc_vfs_lookup(context, path) : NULL;
+    }
+    // searched in order: the includer's directory, the working directory, then every include directory
+    smartptr(list(const char*)) candidates = list_new(const char*);
+    if (name[0] == '/') list_add(candidates) = jitc_append_string(context, name);
+    else {
+        list_add(candidates) = jitc_vfs_join(context, includer, dir_length, name);
+        if (dir_length != 0) list_add(candidates) = jitc_append_string(context, name);
+        for (size_t i = 0; i < list_size(vfs->include_dirs); i++) {
+            const char* dir = list_get(vfs->include_dirs, i);
+            list_add(candidates) = jitc_vfs_join(context, dir, strlen(dir), name);
+        }
+    }
+    jitc_vfs_file_t* file = NULL;
+    for (size_t i = 0; i < list_size(candidates) && !file; i++) {
+        const char* path = list_get(candidates, i);
+        file = jitc_vfs_lookup(context, path);
+        // a file appearing earlier in the search path would change the result, so misses are dependencies too
+        if (!file && context->recording) list_add(context->recording->deps) = (jitc_cache_dep_t){ path, 0, false, true };
+    }
+    map_add(vfs->resolved) = (char*)key;
+    map_commit(vfs->resolved);
+    map_get_value(vfs->resolved) = file ? (char*)file->path : NULL;
+    return file;
+}